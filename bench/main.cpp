@@ -0,0 +1,470 @@
+/**
+ * Microbenchmarks for the Decimal3 hot paths, with int64_t and double baselines.
+ *
+ * usage: bench [--min-time=seconds] [--filter=text] [--out=file.json]
+ *
+ * Each benchmark applies one operation over arrays of inputs and reports the
+ * best of several repetitions as ns/op and ops/s, written as JSON.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "decimal3.h"
+#include "decimal3_atomic.h"
+#include "decimal3_batch.h"
+#include "decimal3_codec.h"
+#include "decimal3_divisor.h"
+#include "decimal3_expr.h"
+#include "decimal3_filter.h"
+#include "decimal3_histogram.h"
+#include "decimal3_packed.h"
+#include "decimal3_reduce.h"
+#include "decimal3_rescale.h"
+#include "decimal3_simd.h"
+#include "decimal3_sort.h"
+#include "decimal3_stream.h"
+
+namespace {
+
+constexpr size_t InputSize = 4096;
+constexpr int Repetitions = 5;
+
+struct Result {
+    std::string name;
+    double ns_per_op;
+    uint64_t ops;
+};
+
+struct Inputs {
+    std::vector<double> da, db;
+    std::vector<int64_t> ia, ib;
+    std::vector<Decimal3> xa, xb;
+    std::vector<Decimal3> prices;
+    std::vector<std::string> text;
+};
+
+template <class T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline uint64_t bits(int64_t x) { return static_cast<uint64_t>(x); }
+inline uint64_t bits(Decimal3 x) { return static_cast<uint64_t>(x.value()); }
+inline uint64_t bits(double x) {
+    uint64_t u;
+    std::memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+/// applies f to every pair of inputs and returns the number of operations
+template <class T, class U, class F>
+uint64_t each(const std::vector<T>& a, const std::vector<U>& b, F f) {
+    uint64_t sink = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        sink += bits(f(a[i], b[i]));
+    do_not_optimize(sink);
+    return a.size();
+}
+
+template <class T, class F>
+uint64_t each(const std::vector<T>& a, F f) {
+    uint64_t sink = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        sink += bits(f(a[i]));
+    do_not_optimize(sink);
+    return a.size();
+}
+
+Inputs make_inputs() {
+    // values with 3 fraction digits in +-1e6, divisors away from zero
+    std::mt19937_64 rng(1);
+    Inputs in;
+    for (size_t i = 0; i < InputSize; i++) {
+        int64_t a = static_cast<int64_t>(rng() % 2000000000) - 1000000000;
+        int64_t b = static_cast<int64_t>(rng() % 2000000) + 1000;
+        if (rng() % 2)
+            b = -b;
+        in.ia.push_back(a);
+        in.ib.push_back(b);
+        in.xa.push_back(Decimal3(a));
+        in.xb.push_back(Decimal3(b));
+        in.da.push_back(Decimal3(a).to_double());
+        in.db.push_back(Decimal3(b).to_double());
+        char buf[Decimal3Params::MaxTextLength];
+        auto result = Decimal3(a).to_chars(buf, buf + sizeof(buf));
+        in.text.emplace_back(buf, result.ptr);
+    }
+    // a random walk by a few thousandths, like tick data
+    int64_t price = 123456789;
+    for (size_t i = 0; i < InputSize; i++) {
+        price += static_cast<int64_t>(rng() % 41) - 20;
+        in.prices.push_back(Decimal3(price));
+    }
+    return in;
+}
+
+class Runner {
+public:
+    Runner(double min_time, const char* filter) : _min_time(min_time), _filter(filter) {}
+
+    /// @brief body runs one pass over the inputs and returns the operations done
+    template <class Body>
+    void run(const char* name, Body body) {
+        if (_filter && !std::strstr(name, _filter))
+            return;
+        using clock = std::chrono::steady_clock;
+        body();
+        Result best { name, 0, 0 };
+        for (int rep = 0; rep < Repetitions; rep++) {
+            uint64_t ops = 0;
+            double elapsed = 0;
+            auto start = clock::now();
+            do {
+                ops += body();
+                elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            } while (elapsed < _min_time / Repetitions);
+            double ns = elapsed * 1e9 / static_cast<double>(ops);
+            if (rep == 0 || ns < best.ns_per_op) {
+                best.ns_per_op = ns;
+                best.ops = ops;
+            }
+        }
+        _results.push_back(best);
+        std::fprintf(stderr, "%-32s %10.3f ns/op\n", name, best.ns_per_op);
+    }
+
+    void write_json(FILE* out) const {
+        static const char* const isa_names[] = { "scalar", "avx2", "avx512" };
+        std::fprintf(out, "{\n");
+        std::fprintf(out, "  \"library\": \"decimal3\",\n");
+#if defined(__VERSION__)
+        std::fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+        std::fprintf(out, "  \"isa\": \"%s\",\n", isa_names[static_cast<int>(Decimal3Simd::active_isa())]);
+        std::fprintf(out, "  \"min_time\": %g,\n", _min_time);
+        std::fprintf(out, "  \"benchmarks\": [\n");
+        for (size_t i = 0; i < _results.size(); i++) {
+            const Result& r = _results[i];
+            std::fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.4f, \"ops_per_sec\": %.0f, \"ops\": %llu}%s\n",
+                         r.name.c_str(), r.ns_per_op, 1e9 / r.ns_per_op,
+                         static_cast<unsigned long long>(r.ops), i + 1 < _results.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+private:
+    double _min_time;
+    const char* _filter;
+    std::vector<Result> _results;
+};
+
+void run_all(Runner& r, const Inputs& in) {
+    // conversions
+    r.run("from_double", [&] { return each(in.da, [](double x) { return Decimal3::from(x); }); });
+    r.run("from_string", [&] { return each(in.text, [](const std::string& s) { return Decimal3::from(s.c_str()); }); });
+    r.run("to_double", [&] { return each(in.xa, [](Decimal3 x) { return x.to_double(); }); });
+    r.run("batch_from_double", [&] {
+        static std::vector<Decimal3> out(InputSize);
+        Decimal3Batch::from_double(in.da.data(), out.data(), InputSize);
+        do_not_optimize(out[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("batch_to_double", [&] {
+        static std::vector<double> out(InputSize);
+        Decimal3Batch::to_double(in.xa.data(), out.data(), InputSize);
+        do_not_optimize(out[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // codec
+    r.run("codec_encode_prices", [&] {
+        static std::vector<uint8_t> out(Decimal3Codec::max_encoded_size(InputSize));
+        Decimal3Codec::Encoder encoder;
+        do_not_optimize(encoder.encode(in.prices.data(), InputSize, out.data()));
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("codec_decode_prices", [&] {
+        static std::vector<uint8_t> bytes;
+        static std::vector<Decimal3> out(InputSize);
+        if (bytes.empty())
+            Decimal3Codec::Encoder().encode(in.prices.data(), InputSize, bytes);
+        Decimal3Codec::Decoder decoder;
+        do_not_optimize(decoder.decode(bytes.data(), bytes.data() + bytes.size(), out.data(), InputSize).count);
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // predicate scans, per element
+    r.run("filter_between_loop", [&] {
+        static std::vector<size_t> index(InputSize);
+        Decimal3 lo = Decimal3::from(-100), hi = Decimal3::from(100);
+        size_t count = 0;
+        for (size_t i = 0; i < InputSize; i++) {
+            Decimal3 x = in.xa[i];
+            if (!x.error() && x >= lo && x <= hi)
+                index[count++] = i;
+        }
+        do_not_optimize(count);
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("filter_between_bitmap", [&] {
+        static std::vector<uint64_t> bitmap(InputSize / 64);
+        do_not_optimize(Decimal3Batch::filter_between(in.xa.data(), InputSize, Decimal3::from(-100), Decimal3::from(100), bitmap.data()));
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("filter_between_select", [&] {
+        static std::vector<size_t> index(InputSize);
+        do_not_optimize(Decimal3Batch::select_between(in.xa.data(), InputSize, Decimal3::from(-100), Decimal3::from(100), index.data()));
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("filter_compare_bitmap", [&] {
+        static std::vector<uint64_t> bitmap(InputSize / 64);
+        do_not_optimize(Decimal3Batch::filter(in.xa.data(), in.xb.data(), InputSize, Decimal3Batch::Compare::Less, bitmap.data()));
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("filter_compact", [&] {
+        static std::vector<uint64_t> bitmap(InputSize / 64);
+        static std::vector<Decimal3> out(InputSize);
+        Decimal3Batch::filter(in.xa.data(), InputSize, Decimal3Batch::Compare::Greater, Decimal3(0), bitmap.data());
+        do_not_optimize(Decimal3Batch::compact(in.xa.data(), bitmap.data(), InputSize, out.data()));
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // bit-packed column of prices, per element
+    static const auto packed = Decimal3PackedColumn::from_vector(in.prices);
+    r.run("packed_decode_prices", [&] {
+        static std::vector<Decimal3> out(InputSize);
+        packed.decode(out.data());
+        do_not_optimize(out[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("packed_get_prices", [&] {
+        uint64_t sink = 0;
+        for (size_t i = 0; i < InputSize; i++)
+            sink += bits(packed[(i * 97) % InputSize]);
+        do_not_optimize(sink);
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("packed_count_between", [&] {
+        do_not_optimize(packed.count_between(in.prices[0], in.prices[0] + Decimal3::from(0.1)));
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("packed_sum", [&] {
+        do_not_optimize(packed.sum());
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // operators
+    r.run("operator+", [&] { return each(in.xa, in.xb, [](Decimal3 a, Decimal3 b) { return a + b; }); });
+    r.run("operator-", [&] { return each(in.xa, in.xb, [](Decimal3 a, Decimal3 b) { return a - b; }); });
+    r.run("operator*", [&] { return each(in.xa, in.xb, [](Decimal3 a, Decimal3 b) { return a * b; }); });
+    r.run("operator/", [&] { return each(in.xa, in.xb, [](Decimal3 a, Decimal3 b) { return a / b; }); });
+    r.run("operator+(double)", [&] { return each(in.xa, in.db, [](Decimal3 a, double b) { return a + b; }); });
+    r.run("operator-(double)", [&] { return each(in.xa, in.db, [](Decimal3 a, double b) { return a - b; }); });
+    r.run("operator*(double)", [&] { return each(in.xa, in.db, [](Decimal3 a, double b) { return a * b; }); });
+    r.run("operator/(double)", [&] { return each(in.xa, in.db, [](Decimal3 a, double b) { return a / b; }); });
+    r.run("negate", [&] { return each(in.xa, [](Decimal3 a) { return -a; }); });
+
+    // primitives
+    r.run("safe_add", [&] { return each(in.ia, in.ib, [](int64_t a, int64_t b) { return Decimal3::safe_add(a, b); }); });
+    r.run("safe_subtract", [&] { return each(in.ia, in.ib, [](int64_t a, int64_t b) { return Decimal3::safe_subtract(a, b); }); });
+    r.run("safe_multiply", [&] { return each(in.ia, in.ib, [](int64_t a, int64_t b) { return Decimal3::safe_multiply(a, b); }); });
+    r.run("safe_multiply(double)", [&] { return each(in.ia, in.db, [](int64_t a, double b) { return Decimal3::safe_multiply(a, b); }); });
+    r.run("safe_divide", [&] { return each(in.ia, in.ib, [](int64_t a, int64_t b) { return Decimal3::safe_divide(a, b); }); });
+    r.run("safe_divide(double)", [&] { return each(in.ia, in.db, [](int64_t a, double b) { return Decimal3::safe_divide(a, b); }); });
+    r.run("safe_double_to_internal_long", [&] { return each(in.da, [](double x) { return Decimal3::safe_double_to_internal_long(x); }); });
+    r.run("parse_string_to_internal_long", [&] { return each(in.text, [](const std::string& s) { return Decimal3::parse_string_to_internal_long(s.c_str()); }); });
+
+    // repeated division by one divisor, per element
+    const Decimal3 fx = in.xb[0];
+    const Decimal3Divisor fx_divisor = Decimal3Divisor::from(fx);
+    r.run("divide_by_same", [&] { return each(in.xa, [fx](Decimal3 a) { return a / fx; }); });
+    r.run("divide_by_divisor", [&] { return each(in.xa, [&fx_divisor](Decimal3 a) { return a / fx_divisor; }); });
+    r.run("batch_divide_by_divisor", [&] {
+        static std::vector<Decimal3> out(InputSize);
+        fx_divisor.divide(in.xa.data(), out.data(), InputSize);
+        do_not_optimize(out[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // venue prices with 6 implied decimals, per element
+    r.run("from_scaled_via_double", [&] { return each(in.ia, [](int64_t x) { return Decimal3::from(static_cast<double>(x) / 1e6); }); });
+    r.run("from_scaled", [&] { return each(in.ia, [](int64_t x) { return Decimal3::from_scaled(x, 6); }); });
+    r.run("batch_from_scaled", [&] {
+        static std::vector<Decimal3> out(InputSize);
+        Decimal3Batch::from_scaled(in.ia.data(), 6, out.data(), InputSize);
+        do_not_optimize(out[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("batch_to_scaled", [&] {
+        static std::vector<int64_t> out(InputSize);
+        Decimal3Batch::to_scaled(in.xa.data(), 6, out.data(), InputSize);
+        do_not_optimize(out[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // dot product, per element
+    r.run("dot", [&] {
+        do_not_optimize(Decimal3Batch::dot(in.xa.data(), in.xb.data(), InputSize));
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("dot_by_operators", [&] {
+        Decimal3 total;
+        for (size_t i = 0; i < InputSize; i++)
+            total += in.xa[i] * in.xb[i];
+        do_not_optimize(total);
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // a * b + c with one rounding, per element
+    r.run("fma", [&] {
+        static std::vector<Decimal3> out(InputSize);
+        Decimal3Batch::fma(in.xa.data(), in.xb.data(), in.xa.data(), out.data(), InputSize);
+        do_not_optimize(out[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("fma_by_safe_fma", [&] {
+        return each(in.xa, in.xb, [](Decimal3 a, Decimal3 b) { return Decimal3(Decimal3::safe_fma(a.value(), b.value(), a.value())); });
+    });
+
+    // price * qty * rate + fee - rebate, per element
+    const Decimal3 rate = Decimal3::from(1.337);
+    const Decimal3 rebate = Decimal3::from(0.125);
+    r.run("formula_by_operators", [&] {
+        static std::vector<Decimal3> out(InputSize);
+        for (size_t i = 0; i < InputSize; i++)
+            out[i] = in.xa[i] * in.xb[i] * rate + in.xa[i] - rebate;
+        do_not_optimize(out[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("formula_expr", [&] {
+        using Decimal3Expr::col;
+        static std::vector<Decimal3> out(InputSize);
+        Decimal3Expr::evaluate(col(in.xa.data()) * col(in.xb.data()) * rate + col(in.xa.data()) - rebate, out.data(), InputSize);
+        do_not_optimize(out[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // the text inputs as one comma separated stream in 1500 byte reads, per value
+    std::string stream;
+    for (auto& s : in.text)
+        stream += s + ",";
+    r.run("stream_parse", [&] {
+        Decimal3Stream::Parser parser;
+        int64_t sum = 0;
+        for (size_t i = 0; i < stream.size(); i += 1500) {
+            size_t end = std::min(stream.size(), i + 1500);
+            parser.feed(stream.data() + i, stream.data() + end, [&sum](Decimal3 v) { sum += v.value(); });
+        }
+        do_not_optimize(sum);
+        return static_cast<uint64_t>(in.text.size());
+    });
+
+    // shared totals, uncontended, per update
+    r.run("atomic_add", [&] {
+        static Decimal3Atomic total;
+        total.store(Decimal3(0));
+        for (size_t i = 0; i < InputSize; i++)
+            total += in.xa[i];
+        do_not_optimize(total.load());
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("sharded_add", [&] {
+        static Decimal3ShardedAccumulator total;
+        total.reset();
+        for (size_t i = 0; i < InputSize; i++)
+            total += in.xa[i];
+        do_not_optimize(total.load());
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // p99 of a sample, per element
+    r.run("quantile_sort_double", [&] {
+        static std::vector<double> v(InputSize);
+        for (size_t i = 0; i < InputSize; i++)
+            v[i] = in.xa[i].to_double();
+        std::sort(v.begin(), v.end());
+        do_not_optimize(v[InputSize * 99 / 100]);
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("quantile_histogram", [&] {
+        static Decimal3Histogram<> h;
+        h.reset();
+        h.add(in.xa.data(), InputSize);
+        do_not_optimize(h.quantile(0.99));
+        return static_cast<uint64_t>(InputSize);
+    });
+
+    // sorting, per element
+    r.run("sort_radix", [&] {
+        static std::vector<Decimal3> v;
+        v = in.xa;
+        Decimal3Batch::sort(v.data(), v.size());
+        do_not_optimize(v[0]);
+        return static_cast<uint64_t>(v.size());
+    });
+    r.run("argsort_radix", [&] {
+        static std::vector<size_t> index(InputSize);
+        Decimal3Batch::argsort(in.xa.data(), InputSize, index.data());
+        do_not_optimize(index[0]);
+        return static_cast<uint64_t>(InputSize);
+    });
+    r.run("baseline_std_sort", [&] {
+        static std::vector<Decimal3> v;
+        v = in.xa;
+        std::sort(v.begin(), v.end(), [](Decimal3 a, Decimal3 b) { return a.value() < b.value(); });
+        do_not_optimize(v[0]);
+        return static_cast<uint64_t>(v.size());
+    });
+
+    // baselines
+    r.run("baseline_int64_add", [&] { return each(in.ia, in.ib, [](int64_t a, int64_t b) { return a + b; }); });
+    r.run("baseline_int64_subtract", [&] { return each(in.ia, in.ib, [](int64_t a, int64_t b) { return a - b; }); });
+    r.run("baseline_int64_multiply", [&] { return each(in.ia, in.ib, [](int64_t a, int64_t b) { return a * b; }); });
+    r.run("baseline_int64_divide", [&] { return each(in.ia, in.ib, [](int64_t a, int64_t b) { return a / b; }); });
+    r.run("baseline_double_add", [&] { return each(in.da, in.db, [](double a, double b) { return a + b; }); });
+    r.run("baseline_double_subtract", [&] { return each(in.da, in.db, [](double a, double b) { return a - b; }); });
+    r.run("baseline_double_multiply", [&] { return each(in.da, in.db, [](double a, double b) { return a * b; }); });
+    r.run("baseline_double_divide", [&] { return each(in.da, in.db, [](double a, double b) { return a / b; }); });
+    r.run("baseline_strtod", [&] { return each(in.text, [](const std::string& s) { return std::strtod(s.c_str(), nullptr); }); });
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    double min_time = 0.5;
+    const char* filter = nullptr;
+    const char* out_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--min-time=", 11) == 0)
+            min_time = std::atof(argv[i] + 11);
+        else if (std::strncmp(argv[i], "--filter=", 9) == 0)
+            filter = argv[i] + 9;
+        else if (std::strncmp(argv[i], "--out=", 6) == 0)
+            out_path = argv[i] + 6;
+        else {
+            std::fprintf(stderr, "usage: %s [--min-time=seconds] [--filter=text] [--out=file.json]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Inputs inputs = make_inputs();
+    Runner runner(min_time, filter);
+    run_all(runner, inputs);
+
+    FILE* out = out_path ? std::fopen(out_path, "w") : stdout;
+    if (!out) {
+        std::fprintf(stderr, "can not open %s\n", out_path);
+        return 1;
+    }
+    runner.write_json(out);
+    if (out != stdout)
+        std::fclose(out);
+    return 0;
+}
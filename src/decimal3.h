@@ -6,399 +6,1087 @@
 
 #ifndef DECIMAL3_H
 #define DECIMAL3_H
-#endif 
 
+#include <charconv>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <functional>
 #include <limits>
-#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#if defined(__cpp_impl_three_way_comparison) && __cpp_impl_three_way_comparison >= 201907L && __has_include(<compare>)
+#include <compare>
+#define DECIMAL3_THREE_WAY_COMPARISON 1
+#else
+#define DECIMAL3_THREE_WAY_COMPARISON 0
+#endif
+
+#if !defined(__SIZEOF_INT128__)
+#error "Decimal3 needs a compiler with __int128 (GCC or Clang on a 64-bit target)"
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DECIMAL3_HAS_IS_CONSTANT_EVALUATED 1
+#else
+#define DECIMAL3_HAS_IS_CONSTANT_EVALUATED 0
+#endif
+
+// SWAR paths are skipped in constant evaluation, so they need a way to detect it
+#if DECIMAL3_HAS_IS_CONSTANT_EVALUATED && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define DECIMAL3_SWAR 1
+#else
+#define DECIMAL3_SWAR 0
+#endif
+
+// Counters of slow and error paths, see decimal3_stats.h. Off by default.
+#ifndef DECIMAL3_STATS
+#define DECIMAL3_STATS 0
+#endif
+
+#if DECIMAL3_STATS
+#if !DECIMAL3_HAS_IS_CONSTANT_EVALUATED
+#error "DECIMAL3_STATS needs a compiler that can detect constant evaluation"
+#endif
+#include "decimal3_stats.h"
+#define DECIMAL3_COUNT(counter) Decimal3Detail::count(Decimal3Stats::Counter::counter)
+#else
+#define DECIMAL3_COUNT(counter) ((void)0)
+#endif
+
+/// Text layout used by Decimal::to_chars()
+enum class DecimalFormat {
+    /// always Scale fraction digits: "1.500", "-0.020", "3.000"
+    Fixed,
+    /// trailing zeros and a bare '.' are removed: "1.5", "-0.02", "3"
+    Trimmed,
+};
 
-namespace Decimal3Params {
+using Decimal3Format = DecimalFormat;
+
+/**
+ * Rounding policies, given as the third template parameter of Decimal.
+ * Parsing, conversion from double, multiplication and division all round
+ * by the policy of their type, so the choice costs no branch at run time.
+ *
+ * round_up() decides whether the truncated magnitude q of a result moves up
+ * by one. r is the remainder of the division by d (0 <= r < d) and negative
+ * is the sign of the exact result.
+ */
+namespace DecimalRounding {
+
+    /// half away from zero: 2.5 -> 3, -2.5 -> -3. The default.
+    struct HalfUp {
+        template <class U>
+        static constexpr bool round_up(U, U r, U d, bool) { return r >= d - r; }
+    };
+
+    /// half to even, banker's rounding: 2.5 -> 2, 3.5 -> 4, -2.5 -> -2
+    struct HalfEven {
+        template <class U>
+        static constexpr bool round_up(U q, U r, U d, bool) { return r > d - r || (r == d - r && (q & 1) != 0); }
+    };
+
+    /// toward negative infinity: 2.7 -> 2, -2.1 -> -3
+    struct Floor {
+        template <class U>
+        static constexpr bool round_up(U, U r, U, bool negative) { return negative && r != 0; }
+    };
+
+    /// toward positive infinity: 2.1 -> 3, -2.7 -> -2
+    struct Ceiling {
+        template <class U>
+        static constexpr bool round_up(U, U r, U, bool negative) { return !negative && r != 0; }
+    };
+
+    /// toward zero: 2.7 -> 2, -2.7 -> -2
+    struct Truncate {
+        template <class U>
+        static constexpr bool round_up(U, U, U, bool) { return false; }
+    };
+}
+
+namespace Decimal3Detail {
+
+    /// Intermediate types for products of two internal values
+    __extension__ typedef __int128 int128;
+    __extension__ typedef unsigned __int128 uint128;
+
+    /// 10^0 .. 10^18
+    constexpr uint64_t Pow10[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+        100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+        10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+        100000000000000000ULL, 1000000000000000000ULL,
+    };
+
+    /// "00" "01" ... "99"
+    constexpr char DigitPairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    /// Type wide enough to hold the product of two values of Storage
+    template <class Storage> struct Wide;
+    template <> struct Wide<int32_t> { using type = int64_t; using utype = uint64_t; };
+    template <> struct Wide<int64_t> { using type = int128;  using utype = uint128;  };
+
+    constexpr int count_digits(uint64_t n) {
+        int digits = 1;
+        while (digits < 20 && n >= Pow10[digits])
+            digits++;
+        return digits;
+    }
+
+    constexpr bool is_constant_evaluated() {
+#if DECIMAL3_HAS_IS_CONSTANT_EVALUATED
+        return __builtin_is_constant_evaluated();
+#else
+        return true;
+#endif
+    }
+
+#if DECIMAL3_STATS
+    constexpr void count(Decimal3Stats::Counter counter) {
+        if (!is_constant_evaluated())
+            Decimal3Stats::detail::increment(counter);
+    }
+#endif
+
+    constexpr bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    /// @brief std::isfinite() usable in constant expressions
+    constexpr bool is_finite(double x) {
+        // inf - inf and nan - nan are nan, which compares unequal to everything
+        return x - x == 0.0;
+    }
+
+    constexpr double abs(double x) {
+        return x < 0 ? -x : x;
+    }
+
+    /// @brief n / d for n >= 0 and d > 0, rounded by Rounding. negative is the sign of the exact quotient.
+    template <class Rounding, class U>
+    constexpr U round_divide(U n, U d, bool negative) {
+        U q = n / d;
+        return q + Rounding::round_up(q, static_cast<U>(n % d), d, negative);
+    }
+
+    /// @brief rounds |x| < 2^63 to an integer by Rounding. negative is the sign of x.
+    template <class Rounding>
+    constexpr uint64_t round_double(double absx, bool negative) {
+        // signed conversions are single instructions, unsigned ones are not
+        int64_t q = static_cast<int64_t>(absx);
+        // exact, as q and absx are within a factor of two
+        double fraction = absx - static_cast<double>(q);
+        // the remainder in twentieths: zero, below, at or above one half
+        uint64_t r = (fraction != 0.0) + 9 * (fraction >= 0.5) + (fraction > 0.5);
+        return static_cast<uint64_t>(q) + Rounding::round_up(static_cast<uint64_t>(q), r, uint64_t(20), negative);
+    }
+
+    /// @brief x * 10^shift, rounded by Rounding when shift < 0, for |shift| <= 18.
+    /// Returns the minimum of int64_t when x is it or when the magnitude of the result exceeds limit.
+    template <class Rounding>
+    constexpr int64_t rescale(int64_t x, int shift, uint64_t limit) {
+        constexpr int64_t error = std::numeric_limits<int64_t>::min();
+        if (x == error)
+            return error;
+        const bool negative = x < 0;
+        uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(x) : static_cast<uint64_t>(x);
+        if (shift >= 0) {
+            if (magnitude > limit / Pow10[shift])
+                return error;
+            magnitude *= Pow10[shift];
+        }
+        else {
+            magnitude = round_divide<Rounding>(magnitude, Pow10[-shift], negative);
+            if (magnitude > limit)
+                return error;
+        }
+        return negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+    }
+
+    constexpr void copy_pair(char* p, uint64_t n) {
+        p[0] = DigitPairs[n * 2];
+        p[1] = DigitPairs[n * 2 + 1];
+    }
+
+    /// @brief writes n in decimal and returns the end. Needs up to 20 bytes.
+    constexpr char* write_unsigned(char* p, uint64_t n) {
+        char* end = p + count_digits(n);
+        char* q = end;
+        while (n >= 100) {
+            uint64_t r = n % 100;
+            n /= 100;
+            q -= 2;
+            copy_pair(q, r);
+        }
+        if (n >= 10) {
+            q -= 2;
+            copy_pair(q, n);
+        }
+        else {
+            *--q = static_cast<char>('0' + n);
+        }
+        return end;
+    }
+
+    /// @brief writes an internal value with Scale fraction digits and returns the end.
+    /// Needs DecimalParams::MaxTextLength bytes.
+    template <int Scale, class Storage>
+    constexpr char* write_decimal(char* p, Storage x, DecimalFormat format) {
+        if (x == std::numeric_limits<Storage>::min()) {
+            p[0] = 'N';
+            p[1] = 'a';
+            p[2] = 'N';
+            return p + 3;
+        }
+        uint64_t magnitude = static_cast<uint64_t>(static_cast<int64_t>(x));
+        if (x < 0) {
+            *p++ = '-';
+            magnitude = 0 - magnitude;
+        }
+        p = write_unsigned(p, magnitude / Pow10[Scale]);
+        uint64_t fraction = magnitude % Pow10[Scale];
+        if (Scale == 0 || (format == DecimalFormat::Trimmed && fraction == 0))
+            return p;
+
+        int digits = Scale;
+        if (format == DecimalFormat::Trimmed) {
+            while (fraction % 10 == 0) {
+                fraction /= 10;
+                digits--;
+            }
+        }
+        *p++ = '.';
+        char* q = p + digits;
+        for (int i = digits; i >= 2; i -= 2) {
+            q -= 2;
+            copy_pair(q, fraction % 100);
+            fraction /= 100;
+        }
+        if (q != p)
+            *--q = static_cast<char>('0' + fraction);
+        return p + digits;
+    }
+
+#if DECIMAL3_SWAR
+    /// @brief loads 8 characters, first character in the lowest byte. Digits become 0-9.
+    inline uint64_t swar_load(const char* p) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        return word ^ 0x3030303030303030ULL;
+    }
+
+    /// @brief returns the number of leading digits (0-8) in a word given by swar_load().
+    inline int swar_digit_count(uint64_t t) {
+        // high bit set in each byte that is not 0-9. A carry out of a flagged
+        // byte can only disturb the bytes after it, never the first flag.
+        uint64_t flags = ((t + 0x7676767676767676ULL) | t) & 0x8080808080808080ULL;
+        if (flags == 0)
+            return 8;
+#if defined(__GNUC__)
+        return __builtin_ctzll(flags) >> 3;
+#else
+        int n = 0;
+        while (!(flags & 0x80ULL)) {
+            flags >>= 8;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    /// @brief converts the first n (1-8) digits of a word given by swar_load().
+    inline uint64_t swar_parse_digits(uint64_t t, int n) {
+        t <<= 8 * (8 - n);
+        t = (t * 10) + (t >> 8);
+        t = (((t & 0x000000FF000000FFULL) * 0x000F424000000064ULL)
+          + (((t >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+        return t;
+    }
+#endif
+}
+
+/**
+ * Limits of Decimal<Scale, Storage>, all computed at compile time.
+ */
+template <int Scale, class Storage>
+struct DecimalParams {
+    static_assert(std::is_same<Storage, int32_t>::value || std::is_same<Storage, int64_t>::value,
+                  "Storage must be int32_t or int64_t");
+    static_assert(Scale >= 0 && Decimal3Detail::Pow10[Scale] <= static_cast<uint64_t>(std::numeric_limits<Storage>::max()) / 10,
+                  "Scale leaves no room for an integer part");
+
+    /// Internal value of 1, 10^Scale
+    static constexpr Storage Factor = static_cast<Storage>(Decimal3Detail::Pow10[Scale]);
 
     /// Maximum long value that can be stored
-    constexpr int64_t LongMax = std::numeric_limits<int64_t>::max();
+    static constexpr Storage LongMax = std::numeric_limits<Storage>::max();
 
     /// Minimum long value that can be stored
-    constexpr int64_t LongMin = std::numeric_limits<int64_t>::min() + 1;
+    static constexpr Storage LongMin = std::numeric_limits<Storage>::min() + 1;
 
     /// Error representation
-    constexpr int64_t ErrorValue = std::numeric_limits<int64_t>::min();
+    static constexpr Storage ErrorValue = std::numeric_limits<Storage>::min();
 
     /// Maximum long value that can be given.
-    constexpr int64_t MaxValue = std::numeric_limits<int64_t>::max() / 1000;
+    static constexpr Storage MaxValue = LongMax / Factor;
 
     /// Maximum double value that can be given
-    constexpr double  MaxValueD = static_cast<double>(MaxValue - 1);
+    static constexpr double  MaxValueD = static_cast<double>(MaxValue - 1);
 
     /// Maximum double value that can be given with correct integer
-    constexpr double  MaxSafeNumD = 9007199254740991.0;
+    static constexpr double  MaxSafeNumD = 9007199254740991.0;
 
     /// Maximum double value that can be given with correct integer, in long
-    constexpr int64_t MaxSafeNum = static_cast<int64_t>(MaxSafeNumD);
+    static constexpr int64_t MaxSafeNum = static_cast<int64_t>(MaxSafeNumD);
 
-    /// Maximum double value that can be given, with 3 digit precisions.
-    constexpr double  MaxAccurateNumD = MaxSafeNumD / 1000.0;
+    /// Maximum double value that can be given, with Scale digit precisions.
+    static constexpr double  MaxAccurateNumD = MaxSafeNumD / Factor;
 
-    /// Maximum double value that can be given, with 3 digit precisions.
-    constexpr double  MaxRoundableAccurateNumD = MaxSafeNumD / 10000.0;
+    /// Maximum double value that can be given, with Scale digit precisions, rounding the next digit.
+    static constexpr double  MaxRoundableAccurateNumD = MaxSafeNumD / (Factor * 10.0);
 
     /// Maximum long value which is safe to convert to double
-    constexpr int64_t MaxAccurateNum = static_cast<int64_t>(MaxSafeNumD) / 1000;
-}
+    static constexpr int64_t MaxAccurateNum = static_cast<int64_t>(MaxSafeNumD) / Factor;
+
+    /// Longest text written by Decimal::to_chars(): sign, integer digits, '.', fraction digits
+    static constexpr int MaxTextLength = 1 + Decimal3Detail::count_digits(static_cast<uint64_t>(MaxValue))
+                                       + (Scale > 0 ? 1 + Scale : 0);
+};
 
-class Decimal3 {
-    int64_t _value;
+/**
+ * Fixed-point decimal with Scale fraction digits, stored as a 10^Scale scaled
+ * Storage integer. Results that need rounding are rounded by Rounding, one of
+ * DecimalRounding. Decimal3 is Decimal<3, int64_t>, rounding half up.
+ */
+template <int Scale, class Storage, class Rounding = DecimalRounding::HalfUp>
+class Decimal {
+    Storage _value;
 public:
-    Decimal3();
-    /// @brief initialize with internal value. Use Decimal3::from() instead.
-    Decimal3(int64_t x);
-    Decimal3(const Decimal3& copy);
-    
+    using Params = DecimalParams<Scale, Storage>;
+    using storage_type = Storage;
+    using rounding_type = Rounding;
+    static constexpr int scale = Scale;
+
+    constexpr Decimal();
+    /// @brief initialize with internal value. Use Decimal::from() instead.
+    constexpr Decimal(Storage x);
+    constexpr Decimal(const Decimal& copy) = default;
+
     /// @brief returns internal value stored
-    int64_t value() const;
+    constexpr Storage value() const;
 
     /// @brief returns true if value is errorneous
-    bool    error() const;
+    constexpr bool    error() const;
 
     /// @brief returns value in double.
-    double  to_double() const;
+    constexpr double  to_double() const;
+
+    /// @brief writes the value as text into [first, last) like std::to_chars, without allocating.
+    /// ErrorValue is written as "NaN". ec is value_too_large when the text does not fit.
+    constexpr std::to_chars_result to_chars(char* first, char* last, DecimalFormat format = DecimalFormat::Fixed) const;
 
     /// @brief returns value in long
-    int64_t to_long() const;
+    constexpr int64_t to_long() const;
+
+    /// @brief returns value with digits implied decimals, 0 to 18, rounded when digits < Scale.
+    /// The minimum of int64_t when value is erroneous or the result does not fit.
+    constexpr int64_t to_scaled(int digits) const;
 
     /// @brief returns value in type specified. value is wrapped in case of OutOfRange.
-    int32_t to_int() const;
-    int16_t to_short() const;
-    uint8_t to_uchar() const;
-    int8_t  to_char() const;
-
-    Decimal3& operator=(const Decimal3& copy);
-
-    Decimal3 operator+(const Decimal3& x) const;
-    Decimal3 operator-(const Decimal3& x) const;
-    Decimal3 operator*(const Decimal3& x) const;
-    
-    Decimal3 operator+(double x) const;
-    Decimal3 operator-(double x) const;
-    Decimal3 operator*(double x) const;
-    Decimal3 operator/(double x) const;
-
-    Decimal3& operator+=(const Decimal3& x);
-    Decimal3& operator-=(const Decimal3& x);
-    Decimal3& operator*=(const Decimal3& x);
-    Decimal3& operator/=(const Decimal3& x);
-
-    static const int64_t ErrorValue = Decimal3Params::ErrorValue;
-
-    static Decimal3 from(int32_t x);
-    static Decimal3 from(uint32_t x);
-    static Decimal3 from(int64_t x);
-    static Decimal3 from(double x);
-    static Decimal3 from(const char* text);
-    static Decimal3 from_internal(int64_t x);
-
-    static int64_t safe_add(int64_t a, int64_t b);
-    static int64_t safe_subtract(int64_t a, int64_t b);
-    static int64_t safe_multiply(int64_t a, int64_t b);
-    static int64_t safe_multiply(int64_t a, double b);
-    static int64_t safe_divide(int64_t a,  double b);
-    static int64_t safe_double_to_internal_long(double x);
-    static int64_t parse_string_to_internal_long(const char* text);
+    constexpr int32_t to_int() const;
+    constexpr int16_t to_short() const;
+    constexpr uint8_t to_uchar() const;
+    constexpr int8_t  to_char() const;
+
+    constexpr Decimal& operator=(const Decimal& copy) = default;
+
+    constexpr Decimal operator-() const;
+
+    constexpr Decimal operator+(const Decimal& x) const;
+    constexpr Decimal operator-(const Decimal& x) const;
+    constexpr Decimal operator*(const Decimal& x) const;
+    constexpr Decimal operator/(const Decimal& x) const;
+
+    constexpr Decimal operator+(double x) const;
+    constexpr Decimal operator-(double x) const;
+    constexpr Decimal operator*(double x) const;
+    constexpr Decimal operator/(double x) const;
+
+    constexpr Decimal& operator+=(const Decimal& x);
+    constexpr Decimal& operator-=(const Decimal& x);
+    constexpr Decimal& operator*=(const Decimal& x);
+    constexpr Decimal& operator/=(const Decimal& x);
+
+    /// Comparisons order by internal value. ErrorValue equals itself and is
+    /// less than every other value, so errors sort first.
+    constexpr bool operator==(const Decimal& x) const;
+    constexpr bool operator!=(const Decimal& x) const;
+    constexpr bool operator< (const Decimal& x) const;
+    constexpr bool operator<=(const Decimal& x) const;
+    constexpr bool operator> (const Decimal& x) const;
+    constexpr bool operator>=(const Decimal& x) const;
+#if DECIMAL3_THREE_WAY_COMPARISON
+    constexpr std::strong_ordering operator<=>(const Decimal& x) const;
+#endif
+
+    static constexpr Storage ErrorValue = Params::ErrorValue;
+
+    static constexpr Decimal from(int32_t x);
+    static constexpr Decimal from(uint32_t x);
+    static constexpr Decimal from(long x);
+    static constexpr Decimal from(long long x);
+    static constexpr Decimal from(double x);
+    static constexpr Decimal from(const char* text);
+    static constexpr Decimal from_internal(Storage x);
+    /// @brief initialize from x with digits implied decimals, 0 to 18: from_scaled(12345, 2) is 123.45.
+    /// Digits past Scale are rounded. ErrorValue when the value does not fit or x is the minimum of int64_t.
+    static constexpr Decimal from_scaled(int64_t x, int digits);
+
+    static constexpr Storage safe_add(Storage a, Storage b);
+    static constexpr Storage safe_subtract(Storage a, Storage b);
+    static constexpr Storage safe_multiply(Storage a, Storage b);
+    static constexpr Storage safe_multiply(Storage a, double b);
+    /// @brief a * b + c with a single rounding
+    static constexpr Storage safe_fma(Storage a, Storage b, Storage c);
+    static constexpr Storage safe_divide(Storage a,  double b);
+    /// @brief divides two internal values. Division by zero is an error.
+    static constexpr Storage safe_divide(Storage a,  Storage b);
+    static constexpr Storage safe_double_to_internal_long(double x);
+    static constexpr Storage parse_string_to_internal_long(const char* text);
+
+    /// @brief parses [-]digits[.digits] in [first, last) like std::from_chars.
+    /// Stops at the first character that does not fit the pattern and returns it in ptr.
+    /// ec is invalid_argument when no digits were found and result_out_of_range on overflow;
+    /// value is left untouched on error.
+    static constexpr std::from_chars_result from_chars(const char* first, const char* last, Decimal& value);
+    static constexpr std::from_chars_result parse_chars_to_internal_long(const char* first, const char* last, Storage& value);
 };
 
-Decimal3 Decimal3::from(int32_t x) {
-    return Decimal3((int64_t)x * 1000);
+using Decimal3 = Decimal<3, int64_t>;
+
+namespace Decimal3Params {
+
+    /// Maximum long value that can be stored
+    constexpr int64_t LongMax = Decimal3::Params::LongMax;
+
+    /// Minimum long value that can be stored
+    constexpr int64_t LongMin = Decimal3::Params::LongMin;
+
+    /// Error representation
+    constexpr int64_t ErrorValue = Decimal3::Params::ErrorValue;
+
+    /// Maximum long value that can be given.
+    constexpr int64_t MaxValue = Decimal3::Params::MaxValue;
+
+    /// Maximum double value that can be given
+    constexpr double  MaxValueD = Decimal3::Params::MaxValueD;
+
+    /// Maximum double value that can be given with correct integer
+    constexpr double  MaxSafeNumD = Decimal3::Params::MaxSafeNumD;
+
+    /// Maximum double value that can be given with correct integer, in long
+    constexpr int64_t MaxSafeNum = Decimal3::Params::MaxSafeNum;
+
+    /// Maximum double value that can be given, with 3 digit precisions.
+    constexpr double  MaxAccurateNumD = Decimal3::Params::MaxAccurateNumD;
+
+    /// Maximum double value that can be given, with 3 digit precisions.
+    constexpr double  MaxRoundableAccurateNumD = Decimal3::Params::MaxRoundableAccurateNumD;
+
+    /// Maximum long value which is safe to convert to double
+    constexpr int64_t MaxAccurateNum = Decimal3::Params::MaxAccurateNum;
+
+    /// Longest text written by Decimal3::to_chars(): sign, 16 digits, '.', 3 digits
+    constexpr int MaxTextLength = Decimal3::Params::MaxTextLength;
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::from(int32_t x) {
+    return from(static_cast<long long>(x));
 }
 
-Decimal3 Decimal3::from(uint32_t x) {
-    return Decimal3((int64_t)x * 1000);
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::from(uint32_t x) {
+    return from(static_cast<long long>(x));
 }
 
-Decimal3 Decimal3::from(int64_t x) {
-    if (x < -Decimal3Params::MaxValue || x > Decimal3Params::MaxValue) {
-        return Decimal3(ErrorValue);
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::from(long x) {
+    return from(static_cast<long long>(x));
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::from(long long x) {
+    if (x < -Params::MaxValue || x > Params::MaxValue) {
+        return Decimal(ErrorValue);
     }
-    return Decimal3(x * 1000);
+    return Decimal(static_cast<Storage>(x * Params::Factor));
 }
 
-Decimal3 Decimal3::from(double x) {
-    return Decimal3(safe_double_to_internal_long(x));
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::from(double x) {
+    return Decimal(safe_double_to_internal_long(x));
 }
 
-Decimal3 Decimal3::from(const char* text) {
-    return Decimal3(parse_string_to_internal_long(text));
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::from(const char* text) {
+    return Decimal(parse_string_to_internal_long(text));
 }
 
-Decimal3 Decimal3::from_internal(int64_t x) {
-    return Decimal3(x);
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::from_internal(Storage x) {
+    return Decimal(x);
 }
 
-int64_t Decimal3::safe_double_to_internal_long(double x) {
-    if (!isfinite(x))
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::from_scaled(int64_t x, int digits) {
+    if (digits < 0 || digits > 18)
+        return Decimal(ErrorValue);
+    int64_t internal = Decimal3Detail::rescale<Rounding>(x, Scale - digits, static_cast<uint64_t>(Params::LongMax));
+    if (internal == std::numeric_limits<int64_t>::min())
+        return Decimal(ErrorValue);
+    return Decimal(static_cast<Storage>(internal));
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::safe_double_to_internal_long(double x) {
+    if (!Decimal3Detail::is_finite(x)) {
+        DECIMAL3_COUNT(DoubleNonFinite);
         return ErrorValue;
-        
-    const double absx = std::abs(x);
-    if (absx > Decimal3Params::MaxValueD) {
+    }
+
+    const double absx = Decimal3Detail::abs(x);
+    if (absx > Params::MaxValueD) {
+        DECIMAL3_COUNT(DoubleOutOfRange);
         return ErrorValue;
     }
-    if (absx <= Decimal3Params::MaxRoundableAccurateNumD) {
-        int64_t tmp = static_cast<int64_t>(absx * 10000.0);
-        if (tmp % 10 >= 5)
-            tmp = (tmp + 10) / 10;
-        else
-            tmp = tmp / 10;
-        
-        return x >= 0 ? tmp : -tmp;
-    }
-    if (absx <= Decimal3Params::MaxAccurateNumD) {
-        return static_cast<int64_t>(x * 1000.0);
-    }
-    if (absx > Decimal3Params::MaxAccurateNumD) {
-        // accept precision loss and convert
-        if (absx > Decimal3Params::MaxSafeNumD / 10.0)
-            return static_cast<int64_t>(x) * 1000;
-        if (absx > Decimal3Params::MaxSafeNumD / 100.0)
-            return static_cast<int64_t>(x * 10.0) * 100;
-        else
-            return static_cast<int64_t>(x * 100) * 10;
+    const bool negative = x < 0;
+    uint64_t magnitude = 0;
+    if (absx <= Params::MaxRoundableAccurateNumD) {
+        // the digit after the last kept one decides, the rest only tells
+        // whether the value is exactly on it
+        double scaled = absx * (Params::Factor * 10.0);
+        uint64_t tmp = static_cast<uint64_t>(scaled);
+        uint64_t q = tmp / 10;
+        uint64_t r = tmp % 10 * 2 + (scaled != static_cast<double>(tmp));
+        // a double next to a value with Scale digits, such as 2.01 at
+        // 20099.999999999996, is that value when it converts back to the double.
+        // Only Floor, Ceiling and Truncate see the difference.
+        if (r == 19 && static_cast<double>(q + 1) / static_cast<double>(Params::Factor) == absx) {
+            q++;
+            r = 0;
+        }
+        else if (r == 1 && static_cast<double>(q) / static_cast<double>(Params::Factor) == absx) {
+            r = 0;
+        }
+        magnitude = q + Rounding::round_up(q, r, uint64_t(20), negative);
+    }
+    else if (absx <= Params::MaxAccurateNumD) {
+        DECIMAL3_COUNT(DoubleRounded);
+        magnitude = Decimal3Detail::round_double<Rounding>(absx * Params::Factor, negative);
     }
-    return ErrorValue;
+    else {
+        // accept precision loss and convert, keeping as many fraction digits
+        // as fit in MaxSafeNumD
+        DECIMAL3_COUNT(DoublePrecisionLoss);
+        int kept = 0;
+        while (kept < Scale && absx <= Params::MaxSafeNumD / static_cast<double>(Decimal3Detail::Pow10[kept + 1]))
+            kept++;
+        magnitude = Decimal3Detail::round_double<Rounding>(absx * static_cast<double>(Decimal3Detail::Pow10[kept]), negative)
+                  * Decimal3Detail::Pow10[Scale - kept];
+    }
+    return static_cast<Storage>(negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude));
 }
 
-int64_t Decimal3::parse_string_to_internal_long(const char* text) {
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::parse_string_to_internal_long(const char* text) {
     if (text == nullptr)
         return ErrorValue;
-    if (strlen(text) == 0)
-        return 0LL;
-    
-    char* next = nullptr;
-    int64_t integer = strtoll(text, &next, 10);
 
-    if (integer < -Decimal3Params::MaxValue || integer > Decimal3Params::MaxValue)
-        return ErrorValue;
+    // leading spaces and '+' are accepted, as strtoll() did
+    while (*text == ' ' || (*text >= '\t' && *text <= '\r'))
+        text++;
+    if (text[0] == '+' && text[1] != '-')
+        text++;
 
-    if (*next == '.') {
-        char buf[5] = "0000";
-        int x = 0;
-        for (next = next + 1, x = 0; next != '\0' && x < 4; next++, x++) {
-            char c = *next;
-            if (c >= '0' && c <= '9')
-                buf[x] = c;
-            else 
-                break;
-        }
-        int32_t decimal = (buf[0] - '0') * 1000
-                        + (buf[1] - '0') * 100
-                        + (buf[2] - '0') * 10
-                        + (buf[3] - '0');
+    // text without digits reads as 0
+    Storage value = 0;
+    auto result = parse_chars_to_internal_long(text, text + std::char_traits<char>::length(text), value);
+    if (result.ec == std::errc::result_out_of_range)
+        return ErrorValue;
+    return value;
+}
 
-        if (decimal % 10 >= 5)
-            decimal = (decimal + 10) / 10;
-        else
-            decimal = decimal / 10;
+template <int Scale, class Storage, class Rounding>
+constexpr std::from_chars_result Decimal<Scale, Storage, Rounding>::from_chars(const char* first, const char* last, Decimal& value) {
+    Storage x = 0;
+    auto result = parse_chars_to_internal_long(first, last, x);
+    if (result.ec == std::errc())
+        value = Decimal(x);
+    return result;
+}
 
-        if (integer == -Decimal3Params::MaxValue || integer == Decimal3Params::MaxValue) {
-            constexpr int max_decimal = Decimal3Params::LongMax - Decimal3Params::MaxValue * 1000;
-            if (decimal < -max_decimal || decimal > max_decimal) {
-                return ErrorValue;
-            } 
+template <int Scale, class Storage, class Rounding>
+constexpr std::from_chars_result Decimal<Scale, Storage, Rounding>::parse_chars_to_internal_long(const char* first, const char* last, Storage& value) {
+    using namespace Decimal3Detail;
+    const char* p = first;
+    bool negative = p != last && *p == '-';
+    if (negative)
+        p++;
+
+    // integer part. Up to 16 digits go through the SWAR path, 8 at a time.
+    // Past MaxValue the integer stops growing, it is an error either way.
+    const char* int_begin = p;
+    uint64_t integer = 0;
+#if DECIMAL3_SWAR
+    while (!is_constant_evaluated() && last - p >= 8 && p - int_begin < 16) {
+        uint64_t t = swar_load(p);
+        int n = swar_digit_count(t);
+        if (n == 0)
+            break;
+        integer = integer * Pow10[n] + swar_parse_digits(t, n);
+        p += n;
+        if (n < 8)
+            break;
+    }
+#endif
+    for (; p != last && is_digit(*p); p++) {
+        if (integer <= static_cast<uint64_t>(Params::MaxValue))
+            integer = integer * 10 + (*p - '0');
+    }
+    bool has_integer = p != int_begin;
+
+    // fraction part. Scale + 1 digits are kept for rounding; of the rest
+    // only whether any of them is nonzero matters.
+    constexpr int keep = Scale + 1;
+    bool has_fraction = false;
+    uint64_t fraction = 0;
+    int fraction_digits = 0;
+    bool sticky = false;
+    if (p != last && *p == '.') {
+        const char* q = p + 1;
+#if DECIMAL3_SWAR
+        if (!is_constant_evaluated() && last - q >= 8) {
+            uint64_t t = swar_load(q);
+            int n = swar_digit_count(t);
+            if (n > 0) {
+                fraction_digits = n < keep ? n : keep;
+                fraction = swar_parse_digits(t, fraction_digits);
+                if (n > keep)
+                    sticky = (t << (8 * (8 - n))) >> (8 * (8 - n + fraction_digits)) != 0;
+                q += n;
+            }
+        }
+#endif
+        for (; q != last && is_digit(*q) && fraction_digits < keep; q++) {
+            fraction = fraction * 10 + (*q - '0');
+            fraction_digits++;
         }
+        for (; q != last && is_digit(*q); q++)
+            sticky |= *q != '0';
+        has_fraction = q != p + 1;
+        if (has_integer || has_fraction)
+            p = q;
+    }
 
-        int sign = integer >= 0 ? 1 : -1;
-        return integer * 1000 + decimal * sign;
+    if (!has_integer && !has_fraction) {
+        DECIMAL3_COUNT(ParseInvalid);
+        return { first, std::errc::invalid_argument };
     }
-    else {
-        return integer * 1000;
+
+    if (integer > static_cast<uint64_t>(Params::MaxValue)) {
+        DECIMAL3_COUNT(ParseOverflow);
+        return { p, std::errc::result_out_of_range };
     }
-}
 
+    // round on the digit after the last kept one
+    uint64_t digits = fraction * Pow10[keep - fraction_digits];
+    uint64_t magnitude = integer * Params::Factor + digits / 10;
+    magnitude += Rounding::round_up(magnitude, digits % 10 * 2 + sticky, uint64_t(20), negative);
+    if (magnitude > static_cast<uint64_t>(Params::LongMax)) {
+        DECIMAL3_COUNT(ParseOverflow);
+        return { p, std::errc::result_out_of_range };
+    }
 
-Decimal3::Decimal3() {
-    _value = 0LL;
+    value = static_cast<Storage>(negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude));
+    return { p, std::errc() };
 }
 
-Decimal3::Decimal3(int64_t x) {
-    _value = x;
+
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding>::Decimal() : _value(0) {
 }
 
-Decimal3::Decimal3(const Decimal3& copy) {
-    _value = copy._value;
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding>::Decimal(Storage x) : _value(x) {
 }
 
-int64_t Decimal3::value() const {
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::value() const {
     return _value;
 }
 
-bool Decimal3::error() const {
-    return _value == Decimal3::ErrorValue;
+template <int Scale, class Storage, class Rounding>
+constexpr bool Decimal<Scale, Storage, Rounding>::error() const {
+    return _value == ErrorValue;
 }
 
-uint8_t Decimal3::to_uchar() const {
-    int64_t x = _value / 1000;
+template <int Scale, class Storage, class Rounding>
+constexpr uint8_t Decimal<Scale, Storage, Rounding>::to_uchar() const {
+    Storage x = _value / Params::Factor;
     return static_cast<uint8_t>(x);
 }
 
-int8_t  Decimal3::to_char() const {
-    int64_t x = _value / 1000;
+template <int Scale, class Storage, class Rounding>
+constexpr int8_t  Decimal<Scale, Storage, Rounding>::to_char() const {
+    Storage x = _value / Params::Factor;
     return static_cast<int8_t >(x);
 }
 
-int16_t Decimal3::to_short() const {
-    int64_t x = _value / 1000;
+template <int Scale, class Storage, class Rounding>
+constexpr int16_t Decimal<Scale, Storage, Rounding>::to_short() const {
+    Storage x = _value / Params::Factor;
     return static_cast<int16_t>(x);
 }
 
-int32_t Decimal3::to_int() const {
-    int64_t x = _value / 1000;
+template <int Scale, class Storage, class Rounding>
+constexpr int32_t Decimal<Scale, Storage, Rounding>::to_int() const {
+    Storage x = _value / Params::Factor;
     return static_cast<int32_t>(x);
 }
 
-int64_t Decimal3::to_long() const {
-    return _value / 1000; 
+template <int Scale, class Storage, class Rounding>
+constexpr int64_t Decimal<Scale, Storage, Rounding>::to_long() const {
+    return _value / Params::Factor;
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr int64_t Decimal<Scale, Storage, Rounding>::to_scaled(int digits) const {
+    if (error() || digits < 0 || digits > 18)
+        return std::numeric_limits<int64_t>::min();
+    return Decimal3Detail::rescale<Rounding>(_value, digits - Scale, static_cast<uint64_t>(std::numeric_limits<int64_t>::max()));
 }
 
-double  Decimal3::to_double() const {
-    if (_value > Decimal3Params::MaxSafeNum) {} //
-    if (_value > Decimal3Params::MaxAccurateNum) {
+template <int Scale, class Storage, class Rounding>
+constexpr double  Decimal<Scale, Storage, Rounding>::to_double() const {
+    if (_value > Params::MaxSafeNum) {} //
+    if (_value > Params::MaxAccurateNum) {
         // result may be imprecise
     }
-    return static_cast<double >(_value) / 1000; 
+    return static_cast<double >(_value) / Params::Factor;
 }
 
-Decimal3& Decimal3::operator=(const Decimal3& copy) {
-    _value = copy._value;
-    return *this;
+template <int Scale, class Storage, class Rounding>
+constexpr std::to_chars_result Decimal<Scale, Storage, Rounding>::to_chars(char* first, char* last, DecimalFormat format) const {
+    if (last - first >= Params::MaxTextLength) {
+        return { Decimal3Detail::write_decimal<Scale>(first, _value, format), std::errc() };
+    }
+    char buf[Params::MaxTextLength] = {};
+    char* end = Decimal3Detail::write_decimal<Scale>(buf, _value, format);
+    if (end - buf > last - first)
+        return { last, std::errc::value_too_large };
+    for (char* p = buf; p != end; p++)
+        *first++ = *p;
+    return { first, std::errc() };
 }
 
-Decimal3 Decimal3::operator+(const Decimal3& other) const {
-    return Decimal3(_value) += other;
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::operator-() const {
+    return error() ? *this : Decimal(static_cast<Storage>(-_value));
 }
 
-Decimal3 Decimal3::operator-(const Decimal3& other) const {
-    return Decimal3(_value) -= other;
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::operator+(const Decimal& other) const {
+    return Decimal(_value) += other;
 }
 
-Decimal3 Decimal3::operator*(const Decimal3& other) const {
-    return Decimal3(safe_multiply(_value, other._value));
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::operator-(const Decimal& other) const {
+    return Decimal(_value) -= other;
 }
 
-Decimal3 Decimal3::operator+(double x) const {
-    return Decimal3(_value) += Decimal3::from(x);
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::operator*(const Decimal& other) const {
+    return Decimal(safe_multiply(_value, other._value));
 }
 
-Decimal3 Decimal3::operator-(double x) const {
-    return Decimal3(_value) -= Decimal3::from(x);
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::operator/(const Decimal& other) const {
+    return Decimal(safe_divide(_value, other._value));
 }
 
-Decimal3 Decimal3::operator*(double x) const {
-    return Decimal3(safe_multiply(_value, x));
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::operator+(double x) const {
+    return Decimal(_value) += Decimal::from(x);
 }
 
-Decimal3 Decimal3::operator/(double x) const {
-    return Decimal3(safe_divide(_value, x));
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::operator-(double x) const {
+    return Decimal(_value) -= Decimal::from(x);
 }
 
-Decimal3& Decimal3::operator+=(const Decimal3& other) {
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::operator*(double x) const {
+    return Decimal(safe_multiply(_value, x));
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding> Decimal<Scale, Storage, Rounding>::operator/(double x) const {
+    return Decimal(safe_divide(_value, x));
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding>& Decimal<Scale, Storage, Rounding>::operator+=(const Decimal& other) {
     _value = safe_add(_value, other._value);
     return *this;
 }
-Decimal3& Decimal3::operator-=(const Decimal3& other) {
+
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding>& Decimal<Scale, Storage, Rounding>::operator-=(const Decimal& other) {
     _value = safe_subtract(_value, other._value);
     return *this;
 }
 
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding>& Decimal<Scale, Storage, Rounding>::operator*=(const Decimal& other) {
+    _value = safe_multiply(_value, other._value);
+    return *this;
+}
 
+template <int Scale, class Storage, class Rounding>
+constexpr Decimal<Scale, Storage, Rounding>& Decimal<Scale, Storage, Rounding>::operator/=(const Decimal& other) {
+    _value = safe_divide(_value, other._value);
+    return *this;
+}
 
+template <int Scale, class Storage, class Rounding>
+constexpr bool Decimal<Scale, Storage, Rounding>::operator==(const Decimal& other) const {
+    return _value == other._value;
+}
 
-int64_t Decimal3::safe_add(int64_t a, int64_t b) {
-    bool a_positive = a >= 0;
-    bool b_positive = b >= 0;
-    if (a_positive != b_positive) {
-        // never overflows
-        return a + b;
-    } 
-    else if (a_positive) { 
-        // both positive pattern
-        if (LLONG_MAX - a < b)
-            return ErrorValue;
-        else
-            return a + b;
+template <int Scale, class Storage, class Rounding>
+constexpr bool Decimal<Scale, Storage, Rounding>::operator!=(const Decimal& other) const {
+    return _value != other._value;
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr bool Decimal<Scale, Storage, Rounding>::operator<(const Decimal& other) const {
+    return _value < other._value;
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr bool Decimal<Scale, Storage, Rounding>::operator<=(const Decimal& other) const {
+    return _value <= other._value;
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr bool Decimal<Scale, Storage, Rounding>::operator>(const Decimal& other) const {
+    return _value > other._value;
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr bool Decimal<Scale, Storage, Rounding>::operator>=(const Decimal& other) const {
+    return _value >= other._value;
+}
+
+#if DECIMAL3_THREE_WAY_COMPARISON
+template <int Scale, class Storage, class Rounding>
+constexpr std::strong_ordering Decimal<Scale, Storage, Rounding>::operator<=>(const Decimal& other) const {
+    return _value <=> other._value;
+}
+#endif
+
+
+
+
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::safe_add(Storage a, Storage b) {
+    if (a == ErrorValue || b == ErrorValue)
+        return ErrorValue;
+    if ((b > 0 && a > Params::LongMax - b) || (b < 0 && a < Params::LongMin - b)) {
+        DECIMAL3_COUNT(AddOverflow);
+        return ErrorValue;
     }
-    else { 
-        // both negative pattern
-        if (a == LLONG_MIN || b == LLONG_MIN)
-            return ErrorValue;
-        else
-            return a + b;
+    return static_cast<Storage>(a + b);
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::safe_subtract(Storage a, Storage b) {
+    if (a == ErrorValue || b == ErrorValue)
+        return ErrorValue;
+    if ((b < 0 && a > Params::LongMax + b) || (b > 0 && a < Params::LongMin + b)) {
+        DECIMAL3_COUNT(AddOverflow);
+        return ErrorValue;
     }
+    return static_cast<Storage>(a - b);
 }
 
-int64_t Decimal3::safe_subtract(int64_t a, int64_t b) {
-    bool a_positive = a >= 0;
-    bool b_positive = b >= 0;
-    if (a_positive == b_positive) {
-        // never overflows (negative overflow results correct answer)
-        return a - b;
-    } 
-    else if (a_positive) { // a is positive, b is negative
-        if (b == LLONG_MIN)
-            return ErrorValue;
-        else if (LLONG_MAX - a < -b)
-            return ErrorValue;
-        else
-            return a - b;
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::safe_multiply(Storage a, Storage b) {
+    using Wide = typename Decimal3Detail::Wide<Storage>::type;
+    using UWide = typename Decimal3Detail::Wide<Storage>::utype;
+    if (a == ErrorValue || b == ErrorValue)
+        return ErrorValue;
+    // the magnitude of the product is divided and rounded
+    if (sizeof(Storage) == 8 && a >= INT32_MIN && a <= INT32_MAX && b >= INT32_MIN && b <= INT32_MAX) {
+        // fits in 64 bit, and the result can not overflow
+        int64_t c = static_cast<int64_t>(a) * b;
+        uint64_t m = c < 0 ? 0 - static_cast<uint64_t>(c) : static_cast<uint64_t>(c);
+        int64_t q = static_cast<int64_t>(Decimal3Detail::round_divide<Rounding>(m, static_cast<uint64_t>(Params::Factor), c < 0));
+        return static_cast<Storage>(c < 0 ? -q : q);
     }
-    else { // a is negative, b is positive
-        if (a == LLONG_MIN)
-            return ErrorValue;
-        else if (LLONG_MIN - a < b)
-            return ErrorValue;
-        else
-            return a - b;
+    Wide c = static_cast<Wide>(a) * b;
+    UWide m = c < 0 ? 0 - static_cast<UWide>(c) : static_cast<UWide>(c);
+    UWide q = Decimal3Detail::round_divide<Rounding>(m, static_cast<UWide>(Params::Factor), c < 0);
+    if (q > static_cast<UWide>(Params::LongMax)) {
+        DECIMAL3_COUNT(MultiplyOverflow);
+        return ErrorValue;
     }
+    return static_cast<Storage>(c < 0 ? -static_cast<Wide>(q) : static_cast<Wide>(q));
 }
 
-int64_t Decimal3::safe_multiply(int64_t a, int64_t b) {
-    auto c = a * b;
-    if (c == 0LL)
-        return 0LL;
-    else if (a > 0 && c / a != b)
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::safe_fma(Storage a, Storage b, Storage c) {
+    using Wide = typename Decimal3Detail::Wide<Storage>::type;
+    using UWide = typename Decimal3Detail::Wide<Storage>::utype;
+    if (a == ErrorValue || b == ErrorValue || c == ErrorValue)
+        return ErrorValue;
+    // |a * b| < 2^(2 * bits - 2) leaves room for c * Factor
+    Wide t = static_cast<Wide>(a) * b + static_cast<Wide>(c) * Params::Factor;
+    UWide m = t < 0 ? 0 - static_cast<UWide>(t) : static_cast<UWide>(t);
+    UWide q = Decimal3Detail::round_divide<Rounding>(m, static_cast<UWide>(Params::Factor), t < 0);
+    if (q > static_cast<UWide>(Params::LongMax)) {
+        DECIMAL3_COUNT(MultiplyOverflow);
         return ErrorValue;
-    else if (c % 1000 >= 500)
-        return c / 1000 + 1;
-    else
-        return c / 1000;
+    }
+    return static_cast<Storage>(t < 0 ? -static_cast<Wide>(q) : static_cast<Wide>(q));
 }
 
-int64_t Decimal3::safe_multiply(int64_t a, double b) {
-    if (!isfinite(b))
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::safe_multiply(Storage a, double b) {
+    if (!Decimal3Detail::is_finite(b)) {
+        DECIMAL3_COUNT(DoubleNonFinite);
         return ErrorValue;
+    }
 
     double c = a * b;
-    if (c > Decimal3Params::LongMax) {
+    double absc = Decimal3Detail::abs(c);
+    if (absc > Params::MaxSafeNumD) {
+        // out of range, or inaccurate (integer part)
+        DECIMAL3_COUNT(MultiplyOverflow);
         return ErrorValue;
     }
-    if (c > Decimal3Params::MaxSafeNumD) {
-        // result is inaccurate (integer part)
-        return ErrorValue;
-    }
-    return static_cast<int64_t>(c);
+    int64_t q = static_cast<int64_t>(Decimal3Detail::round_double<Rounding>(absc, c < 0));
+    return static_cast<Storage>(c < 0 ? -q : q);
 }
 
-int64_t Decimal3::safe_divide(int64_t a, double b) {
-    if (!isfinite(b))
-        throw std::invalid_argument("argument is not finite");
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::safe_divide(Storage a, double b) {
+    if (!Decimal3Detail::is_finite(b)) {
+        DECIMAL3_COUNT(DoubleNonFinite);
+        return ErrorValue;
+    }
 
     double c = a / b;
 
-    if (isinf(c))
+    if (!Decimal3Detail::is_finite(c)) {
+        if (b == 0.0)
+            DECIMAL3_COUNT(DivideByZero);
+        else
+            DECIMAL3_COUNT(DivideOverflow);
         return ErrorValue;
-    if (c > Decimal3Params::MaxSafeNumD) {
+    }
+    double absc = Decimal3Detail::abs(c);
+    if (absc > Params::MaxSafeNumD) {
         // result is inaccurate (integer part)
+        DECIMAL3_COUNT(DivideOverflow);
         return ErrorValue;
     }
-    if (c > Decimal3Params::MaxAccurateNumD) {
+    if (absc > Params::MaxAccurateNumD) {
         // result is inaccurate (decimal part)
+        DECIMAL3_COUNT(DivideOverflow);
+        return ErrorValue;
+    }
+    int64_t q = static_cast<int64_t>(Decimal3Detail::round_double<Rounding>(absc, c < 0));
+    return static_cast<Storage>(c < 0 ? -q : q);
+}
+
+template <int Scale, class Storage, class Rounding>
+constexpr Storage Decimal<Scale, Storage, Rounding>::safe_divide(Storage a, Storage b) {
+    using UWide = typename Decimal3Detail::Wide<Storage>::utype;
+    if (a == ErrorValue || b == ErrorValue)
+        return ErrorValue;
+    if (b == 0) {
+        DECIMAL3_COUNT(DivideByZero);
         return ErrorValue;
     }
-    return static_cast<int64_t>(c);
+
+    // divide magnitudes, then round
+    bool negative = (a < 0) != (b < 0);
+    uint64_t m = a < 0 ? 0 - static_cast<uint64_t>(static_cast<int64_t>(a)) : static_cast<uint64_t>(a);
+    uint64_t d = b < 0 ? 0 - static_cast<uint64_t>(static_cast<int64_t>(b)) : static_cast<uint64_t>(b);
+    uint64_t q = 0;
+    if (m <= static_cast<uint64_t>(Params::MaxValue)) {
+        // m * Factor fits in Storage, and so does the quotient
+        q = Decimal3Detail::round_divide<Rounding>(m * Params::Factor, d, negative);
+    }
+    else {
+        UWide q_wide = Decimal3Detail::round_divide<Rounding>(static_cast<UWide>(m) * Params::Factor, static_cast<UWide>(d), negative);
+        if (q_wide > static_cast<uint64_t>(Params::LongMax)) {
+            DECIMAL3_COUNT(DivideOverflow);
+            return ErrorValue;
+        }
+        q = static_cast<uint64_t>(q_wide);
+    }
+    return static_cast<Storage>(negative ? -static_cast<int64_t>(q) : static_cast<int64_t>(q));
 }
+
+namespace std {
+
+    /// Hashes the internal value, consistent with operator==
+    template <int Scale, class Storage, class Rounding>
+    struct hash<Decimal<Scale, Storage, Rounding>> {
+        size_t operator()(const Decimal<Scale, Storage, Rounding>& x) const noexcept {
+            return std::hash<Storage>()(x.value());
+        }
+    };
+}
+
+namespace Decimal3Literals {
+
+    template <char... Chars>
+    constexpr int64_t literal_value() {
+        // digit separators (1'000.5) are dropped
+        const char chars[] = { Chars... };
+        char text[sizeof...(Chars)] = {};
+        int n = 0;
+        for (char c : chars) {
+            if (c != '\'')
+                text[n++] = c;
+        }
+        int64_t value = 0LL;
+        auto result = Decimal3::parse_chars_to_internal_long(text, text + n, value);
+        if (result.ec != std::errc() || result.ptr != text + n)
+            return Decimal3::ErrorValue;
+        return value;
+    }
+
+    /// @brief 12.345_d3 is parsed at compile time. Invalid or out of range literals do not compile.
+    template <char... Chars>
+    constexpr Decimal3 operator""_d3() {
+        constexpr int64_t value = literal_value<Chars...>();
+        static_assert(value != Decimal3::ErrorValue, "invalid or out of range Decimal3 literal");
+        return Decimal3(value);
+    }
+}
+
+#endif // DECIMAL3_H
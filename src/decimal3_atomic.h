@@ -0,0 +1,190 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_ATOMIC_H
+#define DECIMAL3_ATOMIC_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "decimal3.h"
+
+/**
+ * Decimal3 shared between threads, updated without a lock.
+ *
+ * Additions are compare-and-swap loops around Decimal3::safe_add, so they
+ * round and overflow like operator+=: a total that overflows becomes
+ * ErrorValue and stays ErrorValue, as every later safe_add of it does. Once
+ * in error the value is no longer written, which spares its cache line.
+ */
+class Decimal3Atomic {
+public:
+    constexpr Decimal3Atomic() : _value(0) {}
+    constexpr explicit Decimal3Atomic(Decimal3 x) : _value(x.value()) {}
+
+    Decimal3Atomic(const Decimal3Atomic&) = delete;
+    Decimal3Atomic& operator=(const Decimal3Atomic&) = delete;
+
+    Decimal3 load(std::memory_order order = std::memory_order_seq_cst) const {
+        return Decimal3(_value.load(order));
+    }
+
+    void store(Decimal3 x, std::memory_order order = std::memory_order_seq_cst) {
+        _value.store(x.value(), order);
+    }
+
+    Decimal3 exchange(Decimal3 x, std::memory_order order = std::memory_order_seq_cst) {
+        return Decimal3(_value.exchange(x.value(), order));
+    }
+
+    /// @brief replaces the value with desired if it is expected, else loads it into expected
+    bool compare_exchange(Decimal3& expected, Decimal3 desired, std::memory_order order = std::memory_order_seq_cst) {
+        int64_t e = expected.value();
+        bool exchanged = _value.compare_exchange_strong(e, desired.value(), order);
+        expected = Decimal3(e);
+        return exchanged;
+    }
+
+    /// @brief adds x like operator+= and returns the previous value
+    Decimal3 fetch_add(Decimal3 x, std::memory_order order = std::memory_order_seq_cst) {
+        return Decimal3(update(x.value(), order, Decimal3::safe_add));
+    }
+
+    /// @brief subtracts x like operator-= and returns the previous value
+    Decimal3 fetch_sub(Decimal3 x, std::memory_order order = std::memory_order_seq_cst) {
+        return Decimal3(update(x.value(), order, Decimal3::safe_subtract));
+    }
+
+    /// @brief adds x and returns the new value
+    Decimal3 operator+=(Decimal3 x) {
+        return Decimal3(Decimal3::safe_add(fetch_add(x).value(), x.value()));
+    }
+
+    /// @brief subtracts x and returns the new value
+    Decimal3 operator-=(Decimal3 x) {
+        return Decimal3(Decimal3::safe_subtract(fetch_sub(x).value(), x.value()));
+    }
+
+    /// @brief true when the value is ErrorValue, for example after an overflow
+    bool error() const {
+        return _value.load(std::memory_order_relaxed) == Decimal3::ErrorValue;
+    }
+
+private:
+    /// the load part of order, for an update that ends without a write
+    static constexpr std::memory_order load_order(std::memory_order order) {
+        return order == std::memory_order_release ? std::memory_order_relaxed
+             : order == std::memory_order_acq_rel ? std::memory_order_acquire
+             : order;
+    }
+
+    template <class Op>
+    int64_t update(int64_t x, std::memory_order order, Op op) {
+        // ErrorValue stays, so it is not written again, but the read of it
+        // still synchronizes like the update would have
+        int64_t current = _value.load(load_order(order));
+        while (current != Decimal3::ErrorValue
+               && !_value.compare_exchange_weak(current, op(current, x), order, load_order(order))) {
+        }
+        return current;
+    }
+
+    std::atomic<int64_t> _value;
+};
+
+/**
+ * Total of many write-heavy updates, spread over one Decimal3Atomic per
+ * shard so that threads rarely write the same cache line.
+ *
+ * Each thread adds to its own shard, picked once per thread. load() sums the
+ * shards exactly and is ErrorValue when a shard is or the sum does not fit.
+ * An overflowing shard sticks at ErrorValue even where the order of the
+ * updates would have kept a single total in range. load() sees each shard at
+ * some point during the call, not all of them at one instant.
+ */
+class Decimal3ShardedAccumulator {
+public:
+    static constexpr size_t CacheLine = 64;
+
+    /// @brief shards is rounded up to a power of two; 0 means one per hardware thread.
+    explicit Decimal3ShardedAccumulator(size_t shards = 0) {
+        if (shards == 0)
+            shards = std::thread::hardware_concurrency();
+        size_t count = 1;
+        while (count < shards)
+            count *= 2;
+        _shards.reset(new Shard[count]);
+        _mask = count - 1;
+    }
+
+    Decimal3ShardedAccumulator(const Decimal3ShardedAccumulator&) = delete;
+    Decimal3ShardedAccumulator& operator=(const Decimal3ShardedAccumulator&) = delete;
+
+    /// @brief number of shards
+    size_t size() const {
+        return _mask + 1;
+    }
+
+    void add(Decimal3 x) {
+        local().fetch_add(x, std::memory_order_relaxed);
+    }
+
+    void subtract(Decimal3 x) {
+        local().fetch_sub(x, std::memory_order_relaxed);
+    }
+
+    Decimal3ShardedAccumulator& operator+=(Decimal3 x) {
+        add(x);
+        return *this;
+    }
+
+    Decimal3ShardedAccumulator& operator-=(Decimal3 x) {
+        subtract(x);
+        return *this;
+    }
+
+    /// @brief sum of all shards
+    Decimal3 load() const {
+        Decimal3Detail::int128 sum = 0;
+        for (size_t i = 0; i <= _mask; i++) {
+            Decimal3 x = _shards[i].value.load(std::memory_order_acquire);
+            if (x.error())
+                return x;
+            sum += x.value();
+        }
+        if (sum > Decimal3::Params::LongMax || sum < Decimal3::Params::LongMin)
+            return Decimal3(Decimal3::ErrorValue);
+        return Decimal3(static_cast<int64_t>(sum));
+    }
+
+    /// @brief sets every shard to zero. Updates made during the call may be kept.
+    void reset() {
+        for (size_t i = 0; i <= _mask; i++)
+            _shards[i].value.store(Decimal3(0), std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(CacheLine) Shard {
+        Decimal3Atomic value;
+    };
+
+    static size_t thread_index() {
+        static std::atomic<size_t> next{ 0 };
+        static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    Decimal3Atomic& local() {
+        return _shards[thread_index() & _mask].value;
+    }
+
+    std::unique_ptr<Shard[]> _shards;
+    size_t _mask = 0;
+};
+
+#endif // DECIMAL3_ATOMIC_H
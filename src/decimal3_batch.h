@@ -0,0 +1,536 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_BATCH_H
+#define DECIMAL3_BATCH_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "decimal3.h"
+#include "decimal3_simd.h"
+
+/**
+ * Element-wise arithmetic, conversion and formatting over contiguous arrays.
+ *
+ * Every kernel returns exactly what the matching Decimal3 operator returns for
+ * each element, including ErrorValue for overflowed lanes and error inputs.
+ * Arrays are given as pointer + count; `out` may alias either input.
+ * The int64_t overloads operate on internal values (Decimal3::value()).
+ */
+namespace Decimal3Batch {
+
+    static_assert(sizeof(Decimal3) == sizeof(int64_t), "Decimal3 must be a plain int64_t wrapper");
+    static_assert(std::is_standard_layout<Decimal3>::value, "Decimal3 must be standard layout");
+
+    namespace detail {
+
+        inline const int64_t* raw(const Decimal3* x) { return reinterpret_cast<const int64_t*>(x); }
+        inline int64_t* raw(Decimal3* x) { return reinterpret_cast<int64_t*>(x); }
+
+        inline void add_scalar(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = Decimal3::safe_add(a[i], b[i]);
+        }
+
+        inline void subtract_scalar(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = Decimal3::safe_subtract(a[i], b[i]);
+        }
+
+        /// `b` is a single value when Broadcast is true.
+        template <bool Broadcast>
+        inline void multiply_scalar(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = Decimal3::safe_multiply(a[i], Broadcast ? b[0] : b[i]);
+        }
+
+        inline void from_double_scalar(const double* in, int64_t* out, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = Decimal3::safe_double_to_internal_long(in[i]);
+        }
+
+        inline void to_double_scalar(const int64_t* in, double* out, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = Decimal3(in[i]).to_double();
+        }
+
+#if DECIMAL3_X86_SIMD
+        // The multiply kernels handle lanes where both operands fit in int32 and
+        // |a * b| < 2^50. The product is then exact in a double, so it can be
+        // divided by 1000 in floating point and corrected by one in integer.
+        // Other lanes are recomputed with Decimal3::safe_multiply.
+        constexpr int64_t FastProductLimit = 1LL << 50;
+        constexpr int64_t DoubleMagicBits = 0x4330000000000000LL; // 2^52
+        constexpr double  DoubleMagic = 4503599627370496.0;       // 2^52
+
+        /// c / 1000 rounded half away from zero, like Decimal3::safe_multiply.
+        /// Clears the lanes of fast where |c| + 500 >= FastProductLimit.
+        DECIMAL3_TARGET_AVX2
+        inline __m256i divide_1000_avx2(__m256i c, __m256i& fast) {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i limit = _mm256_set1_epi64x(FastProductLimit);
+            const __m256i half = _mm256_set1_epi64x(500);
+            const __m256i k999 = _mm256_set1_epi64x(999);
+            const __m256i magic_bits = _mm256_set1_epi64x(DoubleMagicBits);
+            const __m256d magic = _mm256_set1_pd(DoubleMagic);
+            const __m256d inv1000 = _mm256_set1_pd(0.001);
+            __m256i neg = _mm256_cmpgt_epi64(zero, c);
+            __m256i t = _mm256_add_epi64(_mm256_blendv_epi8(c, _mm256_sub_epi64(zero, c), neg), half);
+            fast = _mm256_and_si256(fast, _mm256_cmpgt_epi64(limit, t));
+
+            // q = floor(t / 1000), exact after a +-1 correction
+            __m256d td = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(t, magic_bits)), magic);
+            __m256d qd = _mm256_floor_pd(_mm256_mul_pd(td, inv1000));
+            __m256i q = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(qd, magic)), magic_bits);
+            __m256i q1000 = _mm256_sub_epi64(_mm256_slli_epi64(q, 10),
+                            _mm256_add_epi64(_mm256_slli_epi64(q, 4), _mm256_slli_epi64(q, 3)));
+            __m256i r = _mm256_sub_epi64(t, q1000);
+            q = _mm256_add_epi64(q, _mm256_cmpgt_epi64(zero, r));
+            q = _mm256_sub_epi64(q, _mm256_cmpgt_epi64(r, k999));
+            return _mm256_blendv_epi8(q, _mm256_sub_epi64(zero, q), neg);
+        }
+
+        DECIMAL3_TARGET_AVX2
+        inline void add_avx2(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+            const __m256i err = _mm256_set1_epi64x(Decimal3::ErrorValue);
+            const __m256i zero = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+                __m256i r = _mm256_add_epi64(x, y);
+                // overflow when both operands have a sign the result does not
+                __m256i ovf = _mm256_and_si256(_mm256_xor_si256(x, r), _mm256_xor_si256(y, r));
+                __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(zero, ovf),
+                              _mm256_or_si256(_mm256_cmpeq_epi64(x, err), _mm256_cmpeq_epi64(y, err)));
+                r = _mm256_blendv_epi8(r, err, bad);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+            }
+            add_scalar(a + i, b + i, out + i, n - i);
+        }
+
+        DECIMAL3_TARGET_AVX2
+        inline void subtract_avx2(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+            const __m256i err = _mm256_set1_epi64x(Decimal3::ErrorValue);
+            const __m256i zero = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+                __m256i r = _mm256_sub_epi64(x, y);
+                // overflow when operand signs differ and the result sign follows y
+                __m256i ovf = _mm256_and_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(x, r));
+                __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(zero, ovf),
+                              _mm256_or_si256(_mm256_cmpeq_epi64(x, err), _mm256_cmpeq_epi64(y, err)));
+                r = _mm256_blendv_epi8(r, err, bad);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+            }
+            subtract_scalar(a + i, b + i, out + i, n - i);
+        }
+
+        template <bool Broadcast>
+        DECIMAL3_TARGET_AVX2
+        inline void multiply_avx2(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i i32_lo = _mm256_set1_epi64x(static_cast<int64_t>(INT32_MIN) - 1);
+            const __m256i i32_hi = _mm256_set1_epi64x(static_cast<int64_t>(INT32_MAX) + 1);
+            const __m256i yb = Broadcast ? _mm256_set1_epi64x(b[0]) : zero;
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+                __m256i y = Broadcast ? yb : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+                __m256i fast = _mm256_and_si256(
+                    _mm256_and_si256(_mm256_cmpgt_epi64(x, i32_lo), _mm256_cmpgt_epi64(i32_hi, x)),
+                    _mm256_and_si256(_mm256_cmpgt_epi64(y, i32_lo), _mm256_cmpgt_epi64(i32_hi, y)));
+                __m256i q = divide_1000_avx2(_mm256_mul_epi32(x, y), fast);
+
+                int fast_bits = _mm256_movemask_pd(_mm256_castsi256_pd(fast));
+                if (fast_bits != 0xF) {
+                    // patch slow lanes before the store, as out may alias a or b
+                    alignas(32) int64_t tmp[4];
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(tmp), q);
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (!(fast_bits & (1 << lane)))
+                            tmp[lane] = Decimal3::safe_multiply(a[i + lane], Broadcast ? b[0] : b[i + lane]);
+                    }
+                    q = _mm256_load_si256(reinterpret_cast<const __m256i*>(tmp));
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), q);
+            }
+            multiply_scalar<Broadcast>(a + i, Broadcast ? b : b + i, out + i, n - i);
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline void add_avx512(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+            const __m512i err = _mm512_set1_epi64(Decimal3::ErrorValue);
+            const __m512i zero = _mm512_setzero_si512();
+            for (size_t i = 0; i < n; i += 8) {
+                __mmask8 m = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+                __m512i x = _mm512_maskz_loadu_epi64(m, a + i);
+                __m512i y = _mm512_maskz_loadu_epi64(m, b + i);
+                __m512i r = _mm512_add_epi64(x, y);
+                __m512i ovf = _mm512_and_si512(_mm512_xor_si512(x, r), _mm512_xor_si512(y, r));
+                __mmask8 bad = _mm512_cmplt_epi64_mask(ovf, zero)
+                             | _mm512_cmpeq_epi64_mask(x, err)
+                             | _mm512_cmpeq_epi64_mask(y, err);
+                r = _mm512_mask_mov_epi64(r, bad, err);
+                _mm512_mask_storeu_epi64(out + i, m, r);
+            }
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline void subtract_avx512(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+            const __m512i err = _mm512_set1_epi64(Decimal3::ErrorValue);
+            const __m512i zero = _mm512_setzero_si512();
+            for (size_t i = 0; i < n; i += 8) {
+                __mmask8 m = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+                __m512i x = _mm512_maskz_loadu_epi64(m, a + i);
+                __m512i y = _mm512_maskz_loadu_epi64(m, b + i);
+                __m512i r = _mm512_sub_epi64(x, y);
+                __m512i ovf = _mm512_and_si512(_mm512_xor_si512(x, y), _mm512_xor_si512(x, r));
+                __mmask8 bad = _mm512_cmplt_epi64_mask(ovf, zero)
+                             | _mm512_cmpeq_epi64_mask(x, err)
+                             | _mm512_cmpeq_epi64_mask(y, err);
+                r = _mm512_mask_mov_epi64(r, bad, err);
+                _mm512_mask_storeu_epi64(out + i, m, r);
+            }
+        }
+
+        /// c / 1000 rounded half away from zero, like Decimal3::safe_multiply.
+        /// Clears the lanes of fast where |c| + 500 >= FastProductLimit.
+        DECIMAL3_TARGET_AVX512
+        inline __m512i divide_1000_avx512(__m512i c, __mmask8& fast) {
+            const __m512i zero = _mm512_setzero_si512();
+            const __m512i limit = _mm512_set1_epi64(FastProductLimit);
+            const __m512i half = _mm512_set1_epi64(500);
+            const __m512i k1000 = _mm512_set1_epi64(1000);
+            const __m512i one = _mm512_set1_epi64(1);
+            const __m512i magic_bits = _mm512_set1_epi64(DoubleMagicBits);
+            const __m512d magic = _mm512_set1_pd(DoubleMagic);
+            const __m512d inv1000 = _mm512_set1_pd(0.001);
+            __mmask8 neg = _mm512_cmplt_epi64_mask(c, zero);
+            __m512i t = _mm512_add_epi64(_mm512_abs_epi64(c), half);
+            fast &= _mm512_cmplt_epi64_mask(t, limit);
+
+            __m512d td = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(t, magic_bits)), magic);
+            __m512d qd = _mm512_roundscale_pd(_mm512_mul_pd(td, inv1000), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+            __m512i q = _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(qd, magic)), magic_bits);
+            __m512i q1000 = _mm512_sub_epi64(_mm512_slli_epi64(q, 10),
+                            _mm512_add_epi64(_mm512_slli_epi64(q, 4), _mm512_slli_epi64(q, 3)));
+            __m512i r = _mm512_sub_epi64(t, q1000);
+            q = _mm512_mask_sub_epi64(q, _mm512_cmplt_epi64_mask(r, zero), q, one);
+            q = _mm512_mask_add_epi64(q, _mm512_cmpge_epi64_mask(r, k1000), q, one);
+            return _mm512_mask_sub_epi64(q, neg, zero, q);
+        }
+
+        template <bool Broadcast>
+        DECIMAL3_TARGET_AVX512
+        inline void multiply_avx512(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+            const __m512i zero = _mm512_setzero_si512();
+            const __m512i i32_lo = _mm512_set1_epi64(INT32_MIN);
+            const __m512i i32_hi = _mm512_set1_epi64(INT32_MAX);
+            const __m512i yb = Broadcast ? _mm512_set1_epi64(b[0]) : zero;
+            for (size_t i = 0; i < n; i += 8) {
+                __mmask8 m = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+                __m512i x = _mm512_maskz_loadu_epi64(m, a + i);
+                __m512i y = Broadcast ? yb : _mm512_maskz_loadu_epi64(m, b + i);
+                __mmask8 fast = _mm512_cmpge_epi64_mask(x, i32_lo) & _mm512_cmple_epi64_mask(x, i32_hi)
+                              & _mm512_cmpge_epi64_mask(y, i32_lo) & _mm512_cmple_epi64_mask(y, i32_hi);
+                __m512i q = divide_1000_avx512(_mm512_mul_epi32(x, y), fast);
+
+                unsigned slow = m & ~fast;
+                if (slow) {
+                    // patch slow lanes before the store, as out may alias a or b
+                    alignas(64) int64_t tmp[8];
+                    _mm512_store_si512(tmp, q);
+                    while (slow) {
+                        int lane = __builtin_ctz(slow);
+                        slow &= slow - 1;
+                        tmp[lane] = Decimal3::safe_multiply(a[i + lane], Broadcast ? b[0] : b[i + lane]);
+                    }
+                    q = _mm512_load_si512(tmp);
+                }
+                _mm512_mask_storeu_epi64(out + i, m, q);
+            }
+        }
+
+        // from_double handles lanes in the tier of safe_double_to_internal_long
+        // that rounds on the 4th fraction digit, |x| <= MaxRoundableAccurateNumD.
+        // t = trunc(|x| * 10000) is an exact integer below 2^53, so
+        // floor((t + 5) / 10) is taken in floating point and corrected by one.
+        // Other lanes, nan and inf included, go through the scalar function.
+        //
+        // to_double handles |v| < 2^51, which converts exactly by adding the
+        // bits of 1.5 * 2^52, and then divides like Decimal3::to_double().
+        constexpr double  RoundingScale = Decimal3::Params::Factor * 10.0;
+        constexpr int64_t FastDoubleLimit = 1LL << 51;
+        constexpr int64_t SignedMagicBits = 0x4338000000000000LL; // 1.5 * 2^52
+        constexpr double  SignedMagic = 6755399441055744.0;       // 1.5 * 2^52
+
+        DECIMAL3_TARGET_AVX2
+        inline void from_double_avx2(const double* in, int64_t* out, size_t n) {
+            const __m256d sign = _mm256_set1_pd(-0.0);
+            const __m256d limit = _mm256_set1_pd(Decimal3::Params::MaxRoundableAccurateNumD);
+            const __m256d scale = _mm256_set1_pd(RoundingScale);
+            const __m256d zerod = _mm256_setzero_pd();
+            const __m256d one = _mm256_set1_pd(1.0);
+            const __m256d five = _mm256_set1_pd(5.0);
+            const __m256d ten = _mm256_set1_pd(10.0);
+            const __m256d tenth = _mm256_set1_pd(0.1);
+            const __m256d magic = _mm256_set1_pd(DoubleMagic);
+            const __m256i magic_bits = _mm256_set1_epi64x(DoubleMagicBits);
+            const __m256i zero = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256d x = _mm256_loadu_pd(in + i);
+                __m256d ax = _mm256_andnot_pd(sign, x);
+                __m256d fast = _mm256_cmp_pd(ax, limit, _CMP_LE_OQ);
+
+                __m256d u = _mm256_add_pd(_mm256_round_pd(_mm256_mul_pd(ax, scale), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC), five);
+                __m256d q = _mm256_floor_pd(_mm256_mul_pd(u, tenth));
+                __m256d r = _mm256_sub_pd(u, _mm256_mul_pd(q, ten));
+                q = _mm256_add_pd(q, _mm256_and_pd(_mm256_cmp_pd(r, ten, _CMP_GE_OQ), one));
+                q = _mm256_sub_pd(q, _mm256_and_pd(_mm256_cmp_pd(r, zerod, _CMP_LT_OQ), one));
+
+                __m256i v = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(q, magic)), magic_bits);
+                __m256i neg = _mm256_castpd_si256(_mm256_cmp_pd(x, zerod, _CMP_LT_OQ));
+                v = _mm256_blendv_epi8(v, _mm256_sub_epi64(zero, v), neg);
+
+                int fast_bits = _mm256_movemask_pd(fast);
+                if (fast_bits != 0xF) {
+                    alignas(32) int64_t tmp[4];
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(tmp), v);
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (!(fast_bits & (1 << lane)))
+                            tmp[lane] = Decimal3::safe_double_to_internal_long(in[i + lane]);
+                    }
+                    v = _mm256_load_si256(reinterpret_cast<const __m256i*>(tmp));
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+            }
+            from_double_scalar(in + i, out + i, n - i);
+        }
+
+        DECIMAL3_TARGET_AVX2
+        inline void to_double_avx2(const int64_t* in, double* out, size_t n) {
+            const __m256i lo = _mm256_set1_epi64x(-FastDoubleLimit);
+            const __m256i hi = _mm256_set1_epi64x(FastDoubleLimit);
+            const __m256i magic_bits = _mm256_set1_epi64x(SignedMagicBits);
+            const __m256d magic = _mm256_set1_pd(SignedMagic);
+            const __m256d factor = _mm256_set1_pd(static_cast<double>(Decimal3::Params::Factor));
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                __m256i fast = _mm256_and_si256(_mm256_cmpgt_epi64(v, lo), _mm256_cmpgt_epi64(hi, v));
+                __m256d d = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(v, magic_bits)), magic);
+                d = _mm256_div_pd(d, factor);
+
+                int fast_bits = _mm256_movemask_pd(_mm256_castsi256_pd(fast));
+                if (fast_bits != 0xF) {
+                    alignas(32) double tmp[4];
+                    _mm256_store_pd(tmp, d);
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (!(fast_bits & (1 << lane)))
+                            tmp[lane] = Decimal3(in[i + lane]).to_double();
+                    }
+                    d = _mm256_load_pd(tmp);
+                }
+                _mm256_storeu_pd(out + i, d);
+            }
+            to_double_scalar(in + i, out + i, n - i);
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline void from_double_avx512(const double* in, int64_t* out, size_t n) {
+            const __m512d limit = _mm512_set1_pd(Decimal3::Params::MaxRoundableAccurateNumD);
+            const __m512d scale = _mm512_set1_pd(RoundingScale);
+            const __m512d zerod = _mm512_setzero_pd();
+            const __m512d one = _mm512_set1_pd(1.0);
+            const __m512d five = _mm512_set1_pd(5.0);
+            const __m512d ten = _mm512_set1_pd(10.0);
+            const __m512d tenth = _mm512_set1_pd(0.1);
+            const __m512d magic = _mm512_set1_pd(DoubleMagic);
+            const __m512i magic_bits = _mm512_set1_epi64(DoubleMagicBits);
+            const __m512i zero = _mm512_setzero_si512();
+            for (size_t i = 0; i < n; i += 8) {
+                __mmask8 m = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+                __m512d x = _mm512_maskz_loadu_pd(m, in + i);
+                __m512d ax = _mm512_abs_pd(x);
+                __mmask8 fast = _mm512_cmp_pd_mask(ax, limit, _CMP_LE_OQ);
+
+                __m512d u = _mm512_add_pd(_mm512_roundscale_pd(_mm512_mul_pd(ax, scale), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC), five);
+                __m512d q = _mm512_roundscale_pd(_mm512_mul_pd(u, tenth), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+                __m512d r = _mm512_sub_pd(u, _mm512_mul_pd(q, ten));
+                q = _mm512_mask_add_pd(q, _mm512_cmp_pd_mask(r, ten, _CMP_GE_OQ), q, one);
+                q = _mm512_mask_sub_pd(q, _mm512_cmp_pd_mask(r, zerod, _CMP_LT_OQ), q, one);
+
+                __m512i v = _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(q, magic)), magic_bits);
+                v = _mm512_mask_sub_epi64(v, _mm512_cmp_pd_mask(x, zerod, _CMP_LT_OQ), zero, v);
+
+                unsigned slow = m & ~fast;
+                if (slow) {
+                    alignas(64) int64_t tmp[8];
+                    _mm512_store_si512(tmp, v);
+                    while (slow) {
+                        int lane = __builtin_ctz(slow);
+                        slow &= slow - 1;
+                        tmp[lane] = Decimal3::safe_double_to_internal_long(in[i + lane]);
+                    }
+                    v = _mm512_load_si512(tmp);
+                }
+                _mm512_mask_storeu_epi64(out + i, m, v);
+            }
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline void to_double_avx512(const int64_t* in, double* out, size_t n) {
+            const __m512i lo = _mm512_set1_epi64(-FastDoubleLimit);
+            const __m512i hi = _mm512_set1_epi64(FastDoubleLimit);
+            const __m512i magic_bits = _mm512_set1_epi64(SignedMagicBits);
+            const __m512d magic = _mm512_set1_pd(SignedMagic);
+            const __m512d factor = _mm512_set1_pd(static_cast<double>(Decimal3::Params::Factor));
+            for (size_t i = 0; i < n; i += 8) {
+                __mmask8 m = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+                __m512i v = _mm512_maskz_loadu_epi64(m, in + i);
+                __mmask8 fast = _mm512_cmpgt_epi64_mask(v, lo) & _mm512_cmplt_epi64_mask(v, hi);
+                __m512d d = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_add_epi64(v, magic_bits)), magic);
+                d = _mm512_div_pd(d, factor);
+
+                unsigned slow = m & ~fast;
+                if (slow) {
+                    alignas(64) double tmp[8];
+                    _mm512_store_pd(tmp, d);
+                    while (slow) {
+                        int lane = __builtin_ctz(slow);
+                        slow &= slow - 1;
+                        tmp[lane] = Decimal3(in[i + lane]).to_double();
+                    }
+                    d = _mm512_load_pd(tmp);
+                }
+                _mm512_mask_storeu_pd(out + i, m, d);
+            }
+        }
+#endif
+    }
+
+    /// @brief out[i] = a[i] + b[i]
+    inline void add(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+        switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+        case Decimal3Simd::Isa::Avx512: return detail::add_avx512(a, b, out, n);
+        case Decimal3Simd::Isa::Avx2:   return detail::add_avx2(a, b, out, n);
+#endif
+        default: return detail::add_scalar(a, b, out, n);
+        }
+    }
+
+    /// @brief out[i] = a[i] - b[i]
+    inline void subtract(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+        switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+        case Decimal3Simd::Isa::Avx512: return detail::subtract_avx512(a, b, out, n);
+        case Decimal3Simd::Isa::Avx2:   return detail::subtract_avx2(a, b, out, n);
+#endif
+        default: return detail::subtract_scalar(a, b, out, n);
+        }
+    }
+
+    /// @brief out[i] = a[i] * b[i]
+    inline void multiply(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+        switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+        case Decimal3Simd::Isa::Avx512: return detail::multiply_avx512<false>(a, b, out, n);
+        case Decimal3Simd::Isa::Avx2:   return detail::multiply_avx2<false>(a, b, out, n);
+#endif
+        default: return detail::multiply_scalar<false>(a, b, out, n);
+        }
+    }
+
+    /// @brief out[i] = a[i] * k
+    inline void scale(const int64_t* a, int64_t k, int64_t* out, size_t n) {
+        switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+        case Decimal3Simd::Isa::Avx512: return detail::multiply_avx512<true>(a, &k, out, n);
+        case Decimal3Simd::Isa::Avx2:   return detail::multiply_avx2<true>(a, &k, out, n);
+#endif
+        default: return detail::multiply_scalar<true>(a, &k, out, n);
+        }
+    }
+
+    /// @brief out[i] = Decimal3::from(in[i]).value()
+    inline void from_double(const double* in, int64_t* out, size_t n) {
+        switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+        case Decimal3Simd::Isa::Avx512: return detail::from_double_avx512(in, out, n);
+        case Decimal3Simd::Isa::Avx2:   return detail::from_double_avx2(in, out, n);
+#endif
+        default: return detail::from_double_scalar(in, out, n);
+        }
+    }
+
+    /// @brief out[i] = Decimal3(in[i]).to_double()
+    inline void to_double(const int64_t* in, double* out, size_t n) {
+        switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+        case Decimal3Simd::Isa::Avx512: return detail::to_double_avx512(in, out, n);
+        case Decimal3Simd::Isa::Avx2:   return detail::to_double_avx2(in, out, n);
+#endif
+        default: return detail::to_double_scalar(in, out, n);
+        }
+    }
+
+    inline void add(const Decimal3* a, const Decimal3* b, Decimal3* out, size_t n) {
+        add(detail::raw(a), detail::raw(b), detail::raw(out), n);
+    }
+
+    inline void subtract(const Decimal3* a, const Decimal3* b, Decimal3* out, size_t n) {
+        subtract(detail::raw(a), detail::raw(b), detail::raw(out), n);
+    }
+
+    inline void multiply(const Decimal3* a, const Decimal3* b, Decimal3* out, size_t n) {
+        multiply(detail::raw(a), detail::raw(b), detail::raw(out), n);
+    }
+
+    inline void scale(const Decimal3* a, Decimal3 k, Decimal3* out, size_t n) {
+        scale(detail::raw(a), k.value(), detail::raw(out), n);
+    }
+
+    inline void from_double(const double* in, Decimal3* out, size_t n) {
+        from_double(in, detail::raw(out), n);
+    }
+
+    inline void to_double(const Decimal3* in, double* out, size_t n) {
+        to_double(detail::raw(in), out, n);
+    }
+
+    /// @brief writes n values as text into [first, last), separated by `separator`.
+    /// Nothing is allocated; ec is value_too_large and ptr is last when the buffer is too small.
+    inline std::to_chars_result to_chars(char* first, char* last, const Decimal3* values, size_t n,
+                                         char separator = ',', Decimal3Format format = Decimal3Format::Fixed) {
+        char* p = first;
+        for (size_t i = 0; i < n; i++) {
+            if (i != 0) {
+                if (p == last)
+                    return { last, std::errc::value_too_large };
+                *p++ = separator;
+            }
+            // skip the bounds check while the buffer is far from full
+            if (last - p >= Decimal3Params::MaxTextLength) {
+                p = Decimal3Detail::write_decimal<3>(p, values[i].value(), format);
+                continue;
+            }
+            auto result = values[i].to_chars(p, last, format);
+            if (result.ec != std::errc())
+                return result;
+            p = result.ptr;
+        }
+        return { p, std::errc() };
+    }
+}
+
+#endif // DECIMAL3_BATCH_H
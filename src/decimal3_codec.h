@@ -0,0 +1,184 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_CODEC_H
+#define DECIMAL3_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <vector>
+#include "decimal3.h"
+
+/**
+ * Compact binary encoding of Decimal3 streams.
+ *
+ * Each value is stored as the difference from the previous one (the first
+ * from 0), zigzag mapped so small negative deltas stay small, and written as
+ * a LEB128 varint of 1 to 10 bytes. Deltas wrap around in 64 bits, so every
+ * internal value round-trips, ErrorValue included. The stream has no header
+ * or count; framing is left to the caller.
+ */
+namespace Decimal3Codec {
+
+    /// Longest encoding of one value
+    constexpr size_t MaxVarintBytes = 10;
+
+    /// @brief bytes needed to encode n values in the worst case
+    constexpr size_t max_encoded_size(size_t n) {
+        return n * MaxVarintBytes;
+    }
+
+    namespace detail {
+
+        constexpr uint64_t zigzag(uint64_t delta) {
+            return (delta << 1) ^ (0 - (delta >> 63));
+        }
+
+        constexpr uint64_t unzigzag(uint64_t z) {
+            return (z >> 1) ^ (0 - (z & 1));
+        }
+
+        inline uint8_t* write_varint(uint8_t* p, uint64_t z) {
+            while (z >= 0x80) {
+                *p++ = static_cast<uint8_t>(z | 0x80);
+                z >>= 7;
+            }
+            *p++ = static_cast<uint8_t>(z);
+            return p;
+        }
+
+#if DECIMAL3_SWAR
+        /// packs the low 7 bits of each byte of x into 56 bits
+        inline uint64_t compact7(uint64_t x) {
+            x &= 0x7F7F7F7F7F7F7F7FULL;
+            x = (x & 0x007F007F007F007FULL) | ((x & 0x7F007F007F007F00ULL) >> 1);
+            x = (x & 0x00003FFF00003FFFULL) | ((x & 0x3FFF00003FFF0000ULL) >> 2);
+            x = (x & 0x000000000FFFFFFFULL) | ((x & 0x0FFFFFFF00000000ULL) >> 4);
+            return x;
+        }
+#endif
+    }
+
+    /// Result of Decoder::decode()
+    struct DecodeResult {
+        /// first byte not consumed
+        const uint8_t* ptr;
+        /// values written
+        size_t count;
+        /// invalid_argument when a varint is longer than MaxVarintBytes
+        std::errc ec;
+    };
+
+    class Encoder {
+    public:
+        /// @brief writes n values to out, which needs max_encoded_size(n) bytes, and returns the end.
+        uint8_t* encode(const Decimal3* values, size_t n, uint8_t* out) {
+            uint64_t prev = _prev;
+            for (size_t i = 0; i < n; i++) {
+                uint64_t v = static_cast<uint64_t>(values[i].value());
+                out = detail::write_varint(out, detail::zigzag(v - prev));
+                prev = v;
+            }
+            _prev = prev;
+            return out;
+        }
+
+        /// @brief appends the encoding of n values to out
+        void encode(const Decimal3* values, size_t n, std::vector<uint8_t>& out) {
+            size_t size = out.size();
+            out.resize(size + max_encoded_size(n));
+            uint8_t* end = encode(values, n, out.data() + size);
+            out.resize(static_cast<size_t>(end - out.data()));
+        }
+
+        /// @brief starts a new stream
+        void reset() { _prev = 0; }
+
+    private:
+        uint64_t _prev = 0;
+    };
+
+    class Decoder {
+    public:
+        /// @brief decodes up to n values from [first, last) into out.
+        /// A varint cut off at last is not consumed; pass it again with the bytes that follow.
+        DecodeResult decode(const uint8_t* first, const uint8_t* last, Decimal3* out, size_t n) {
+            const uint8_t* p = first;
+            uint64_t prev = _prev;
+            size_t i = 0;
+            for (; i < n && p != last; i++) {
+#if DECIMAL3_SWAR
+                // 8 byte loads while they stay in the buffer;
+                // 9 and 10 byte varints take the byte loop
+                if (last - p >= 8) {
+                    uint64_t x;
+                    std::memcpy(&x, p, sizeof(x));
+                    if ((x & 0x8080808080808080ULL) == 0 && n - i >= 8) {
+                        // eight single byte deltas, the common case for tick data
+                        for (int k = 0; k < 8; k++) {
+                            prev += detail::unzigzag((x >> (8 * k)) & 0x7F);
+                            out[i + k] = Decimal3(static_cast<int64_t>(prev));
+                        }
+                        i += 7; // and one more by the loop
+                        p += 8;
+                        continue;
+                    }
+                    uint64_t stops = ~x & 0x8080808080808080ULL;
+                    if (stops != 0) {
+                        int bytes = __builtin_ctzll(stops) / 8 + 1;
+                        uint64_t mask = bytes == 8 ? ~0ULL : (1ULL << (8 * bytes)) - 1;
+                        prev += detail::unzigzag(detail::compact7(x & mask));
+                        out[i] = Decimal3(static_cast<int64_t>(prev));
+                        p += bytes;
+                        continue;
+                    }
+                }
+#endif
+                uint64_t z = 0;
+                const uint8_t* q = p;
+                for (int shift = 0;; shift += 7) {
+                    if (q == last) {
+                        _prev = prev;
+                        return { p, i, std::errc() };
+                    }
+                    uint8_t byte = *q++;
+                    if (shift == 63 && byte > 1) {
+                        _prev = prev;
+                        return { p, i, std::errc::invalid_argument };
+                    }
+                    z |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                    if (!(byte & 0x80))
+                        break;
+                }
+                prev += detail::unzigzag(z);
+                out[i] = Decimal3(static_cast<int64_t>(prev));
+                p = q;
+            }
+            _prev = prev;
+            return { p, i, std::errc() };
+        }
+
+        /// @brief decodes every whole value in [first, last), appending to out
+        DecodeResult decode(const uint8_t* first, const uint8_t* last, std::vector<Decimal3>& out) {
+            size_t size = out.size();
+            // every value takes at least one byte
+            out.resize(size + static_cast<size_t>(last - first));
+            DecodeResult result = decode(first, last, out.data() + size, static_cast<size_t>(last - first));
+            out.resize(size + result.count);
+            return result;
+        }
+
+        /// @brief starts a new stream
+        void reset() { _prev = 0; }
+
+    private:
+        uint64_t _prev = 0;
+    };
+}
+
+#endif // DECIMAL3_CODEC_H
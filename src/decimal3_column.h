@@ -0,0 +1,245 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_COLUMN_H
+#define DECIMAL3_COLUMN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include "decimal3.h"
+#include "decimal3_batch.h"
+
+namespace Decimal3Detail {
+
+    /// Allocator returning cache line aligned storage
+    template <class T, size_t Alignment = 64>
+    struct AlignedAllocator {
+        using value_type = T;
+        template <class U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+        AlignedAllocator() = default;
+        template <class U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+        }
+        void deallocate(T* p, size_t) {
+            ::operator delete(p, std::align_val_t(Alignment));
+        }
+        template <class U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+        template <class U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+    };
+}
+
+/**
+ * Column of Decimal3 values with an out-of-band validity bitmap, like Arrow.
+ *
+ * Values are raw int64_t internal values in cache line aligned storage. Errors
+ * and nulls are recorded as a cleared bit in the validity bitmap (bit i of word
+ * i / 64), so valid rows never hold ErrorValue and kernels do not need to test
+ * for it. The value of an invalid row is unspecified.
+ */
+class Decimal3Column {
+public:
+    /// Rows per validity word
+    static constexpr size_t BlockRows = 64;
+
+    Decimal3Column() = default;
+
+    /// @brief n rows of valid zeros
+    explicit Decimal3Column(size_t n)
+        : _values(n, 0), _validity(word_count(n), ~0ULL), _size(n) {
+        clear_tail();
+    }
+
+    /// @brief copies values; ErrorValue becomes an invalid row
+    static Decimal3Column from_vector(const std::vector<Decimal3>& values) {
+        return from_array(values.data(), values.size());
+    }
+
+    static Decimal3Column from_array(const Decimal3* values, size_t n) {
+        Decimal3Column column;
+        column._size = n;
+        column._values.resize(n);
+        column._validity.assign(word_count(n), 0);
+        const int64_t* raw = Decimal3Batch::detail::raw(values);
+        std::copy(raw, raw + n, column._values.begin());
+        column.update_validity(0, n, nullptr, nullptr);
+        return column;
+    }
+
+    /// @brief copies values; invalid rows become ErrorValue
+    std::vector<Decimal3> to_vector() const {
+        std::vector<Decimal3> out(_size);
+        for (size_t i = 0; i < _size; i++) {
+            // mask instead of branch: all ones for a valid row
+            int64_t keep = -static_cast<int64_t>((_validity[i / BlockRows] >> (i % BlockRows)) & 1);
+            out[i] = Decimal3((_values[i] & keep) | (Decimal3::ErrorValue & ~keep));
+        }
+        return out;
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    /// @brief number of invalid rows
+    size_t null_count() const {
+        size_t valid = 0;
+        for (uint64_t word : _validity)
+            valid += popcount(word);
+        return _size - valid;
+    }
+
+    bool valid(size_t i) const {
+        return (_validity[i / BlockRows] >> (i % BlockRows)) & 1;
+    }
+
+    /// @brief returns row i, or ErrorValue when the row is invalid
+    Decimal3 get(size_t i) const {
+        return valid(i) ? Decimal3(_values[i]) : Decimal3(Decimal3::ErrorValue);
+    }
+
+    Decimal3 operator[](size_t i) const {
+        return get(i);
+    }
+
+    /// @brief stores x in row i; ErrorValue makes the row invalid
+    void set(size_t i, Decimal3 x) {
+        if (x.error()) {
+            set_null(i);
+            return;
+        }
+        _values[i] = x.value();
+        _validity[i / BlockRows] |= 1ULL << (i % BlockRows);
+    }
+
+    void set_null(size_t i) {
+        _values[i] = 0;
+        _validity[i / BlockRows] &= ~(1ULL << (i % BlockRows));
+    }
+
+    void push_back(Decimal3 x) {
+        resize(_size + 1);
+        set(_size - 1, x);
+    }
+
+    void push_null() {
+        resize(_size + 1);
+        set_null(_size - 1);
+    }
+
+    /// @brief new rows are valid zeros
+    void resize(size_t n) {
+        size_t old = _size;
+        _values.resize(n, 0);
+        _validity.resize(word_count(n), 0);
+        _size = n;
+        for (size_t i = old; i < n && i % BlockRows != 0; i++)
+            _validity[i / BlockRows] |= 1ULL << (i % BlockRows);
+        for (size_t w = (old + BlockRows - 1) / BlockRows; w < _validity.size(); w++)
+            _validity[w] = ~0ULL;
+        clear_tail();
+    }
+
+    void reserve(size_t n) {
+        _values.reserve(n);
+        _validity.reserve(word_count(n));
+    }
+
+    /// @brief raw internal values, one per row
+    const int64_t* values() const { return _values.data(); }
+    int64_t* values() { return _values.data(); }
+
+    /// @brief validity bitmap, (size() + 63) / 64 words. Bits past size() are zero.
+    const uint64_t* validity() const { return _validity.data(); }
+    uint64_t* validity() { return _validity.data(); }
+
+    /// @brief recomputes validity of rows [begin, end) from their values and the given input bitmaps.
+    /// A row stays valid when it is valid in each non-null input and its value is not ErrorValue.
+    /// begin must be a multiple of BlockRows.
+    void update_validity(size_t begin, size_t end, const uint64_t* a, const uint64_t* b) {
+        for (size_t row = begin; row < end; row += BlockRows) {
+            size_t w = row / BlockRows;
+            size_t rows = end - row < BlockRows ? end - row : BlockRows;
+            uint64_t errors = 0;
+            for (size_t j = 0; j < rows; j++)
+                errors |= static_cast<uint64_t>(_values[row + j] == Decimal3::ErrorValue) << j;
+            uint64_t word = rows == BlockRows ? ~0ULL : (1ULL << rows) - 1;
+            if (a)
+                word &= a[w];
+            if (b)
+                word &= b[w];
+            _validity[w] = word & ~errors;
+        }
+    }
+
+private:
+    std::vector<int64_t, Decimal3Detail::AlignedAllocator<int64_t>> _values;
+    std::vector<uint64_t> _validity;
+    size_t _size = 0;
+
+    static size_t word_count(size_t n) {
+        return (n + BlockRows - 1) / BlockRows;
+    }
+
+    static size_t popcount(uint64_t x) {
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_popcountll(x));
+#else
+        size_t n = 0;
+        for (; x; x &= x - 1)
+            n++;
+        return n;
+#endif
+    }
+
+    void clear_tail() {
+        if (_size % BlockRows != 0)
+            _validity.back() &= (1ULL << (_size % BlockRows)) - 1;
+    }
+};
+
+/**
+ * Column kernels. Values go through the Decimal3Batch kernels, and the output
+ * bitmap is the AND of the input bitmaps with overflowed rows cleared.
+ * `out` is resized to the input size and may be one of the inputs.
+ */
+namespace Decimal3Batch {
+
+    namespace detail {
+        template <class Kernel>
+        inline void column_binary(const Decimal3Column& a, const Decimal3Column& b, Decimal3Column& out, Kernel kernel) {
+            size_t n = a.size() < b.size() ? a.size() : b.size();
+            out.resize(n);
+            kernel(a.values(), b.values(), out.values(), n);
+            out.update_validity(0, n, a.validity(), b.validity());
+        }
+    }
+
+    inline void add(const Decimal3Column& a, const Decimal3Column& b, Decimal3Column& out) {
+        detail::column_binary(a, b, out, [](const int64_t* x, const int64_t* y, int64_t* r, size_t n) { add(x, y, r, n); });
+    }
+
+    inline void subtract(const Decimal3Column& a, const Decimal3Column& b, Decimal3Column& out) {
+        detail::column_binary(a, b, out, [](const int64_t* x, const int64_t* y, int64_t* r, size_t n) { subtract(x, y, r, n); });
+    }
+
+    inline void multiply(const Decimal3Column& a, const Decimal3Column& b, Decimal3Column& out) {
+        detail::column_binary(a, b, out, [](const int64_t* x, const int64_t* y, int64_t* r, size_t n) { multiply(x, y, r, n); });
+    }
+
+    inline void scale(const Decimal3Column& a, Decimal3 k, Decimal3Column& out) {
+        size_t n = a.size();
+        out.resize(n);
+        scale(a.values(), k.value(), out.values(), n);
+        out.update_validity(0, n, a.validity(), nullptr);
+    }
+}
+
+#endif // DECIMAL3_COLUMN_H
@@ -0,0 +1,149 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_CONTEXT_H
+#define DECIMAL3_CONTEXT_H
+
+#include <cstdint>
+#include <system_error>
+#include "decimal3.h"
+
+/**
+ * Sticky status flags raised by DecimalContext, one set per thread.
+ * Operations only set flags; they stay raised until clear() is called.
+ */
+namespace DecimalStatus {
+
+    /// result does not fit in the range
+    constexpr unsigned Overflow     = 1u << 0;
+    /// non-finite double, or text that is not a number
+    constexpr unsigned Invalid      = 1u << 1;
+    /// double conversion did not keep the exact value
+    constexpr unsigned Inexact      = 1u << 2;
+    /// division by zero
+    constexpr unsigned DivideByZero = 1u << 3;
+
+    constexpr unsigned All = Overflow | Invalid | Inexact | DivideByZero;
+
+    inline unsigned& flags() {
+        static thread_local unsigned raised = 0;
+        return raised;
+    }
+
+    inline void raise(unsigned mask) {
+        flags() |= mask;
+    }
+
+    /// @brief returns the raised flags among mask
+    inline unsigned test(unsigned mask = All) {
+        return flags() & mask;
+    }
+
+    inline void clear(unsigned mask = All) {
+        flags() &= ~mask;
+    }
+}
+
+/**
+ * Arithmetic that reports errors through DecimalStatus instead of testing
+ * for ErrorValue on every operation.
+ *
+ * Operands are assumed valid. Results that can not be represented are
+ * ErrorValue and raise a flag, so a long formula can run without branches and
+ * be checked once with DecimalStatus::test(). An ErrorValue operand gives an
+ * unspecified result, but the flag raised when it was produced is still set.
+ */
+template <int Scale, class Storage, class Rounding = DecimalRounding::HalfUp>
+struct DecimalContext {
+    using Value = Decimal<Scale, Storage, Rounding>;
+    using Params = typename Value::Params;
+
+    static Value add(Value a, Value b) {
+        Storage r = 0;
+        bool overflow = __builtin_add_overflow(a.value(), b.value(), &r);
+        return checked(r, overflow | (r == Value::ErrorValue));
+    }
+
+    static Value subtract(Value a, Value b) {
+        Storage r = 0;
+        bool overflow = __builtin_sub_overflow(a.value(), b.value(), &r);
+        return checked(r, overflow | (r == Value::ErrorValue));
+    }
+
+    /// @brief rounds like operator*
+    static Value multiply(Value a, Value b) {
+        Storage r = Value::safe_multiply(a.value(), b.value());
+        return checked(r, r == Value::ErrorValue);
+    }
+
+    /// @brief rounds like operator/
+    static Value divide(Value a, Value b) {
+        if (b.value() == 0) {
+            DecimalStatus::raise(DecimalStatus::DivideByZero);
+            return Value(Value::ErrorValue);
+        }
+        Storage r = Value::safe_divide(a.value(), b.value());
+        return checked(r, r == Value::ErrorValue);
+    }
+
+    static Value multiply(Value a, double b) {
+        if (!Decimal3Detail::is_finite(b))
+            return invalid();
+        Storage r = Value::safe_multiply(a.value(), b);
+        return checked(r, r == Value::ErrorValue);
+    }
+
+    static Value divide(Value a, double b) {
+        if (!Decimal3Detail::is_finite(b))
+            return invalid();
+        if (b == 0.0) {
+            DecimalStatus::raise(DecimalStatus::DivideByZero);
+            return Value(Value::ErrorValue);
+        }
+        Storage r = Value::safe_divide(a.value(), b);
+        return checked(r, r == Value::ErrorValue);
+    }
+
+    /// @brief raises Inexact when the result does not convert back to x
+    static Value from(double x) {
+        if (!Decimal3Detail::is_finite(x))
+            return invalid();
+        Storage r = Value::safe_double_to_internal_long(x);
+        if (r == Value::ErrorValue) {
+            DecimalStatus::raise(DecimalStatus::Overflow);
+            return Value(r);
+        }
+        if (static_cast<double>(r) / Params::Factor != x)
+            DecimalStatus::raise(DecimalStatus::Inexact);
+        return Value(r);
+    }
+
+    /// @brief parses the whole of [first, last) as [-]digits[.digits]
+    static Value parse(const char* first, const char* last) {
+        Storage r = 0;
+        auto result = Value::parse_chars_to_internal_long(first, last, r);
+        if (result.ec == std::errc::result_out_of_range)
+            return checked(r, true);
+        if (result.ec != std::errc() || result.ptr != last)
+            return invalid();
+        return Value(r);
+    }
+
+private:
+    static Value checked(Storage r, bool overflow) {
+        DecimalStatus::raise(overflow ? DecimalStatus::Overflow : 0u);
+        return Value(overflow ? Value::ErrorValue : r);
+    }
+
+    static Value invalid() {
+        DecimalStatus::raise(DecimalStatus::Invalid);
+        return Value(Value::ErrorValue);
+    }
+};
+
+using Decimal3Context = DecimalContext<3, int64_t>;
+
+#endif // DECIMAL3_CONTEXT_H
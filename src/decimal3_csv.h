@@ -0,0 +1,322 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_CSV_H
+#define DECIMAL3_CSV_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <vector>
+#include "decimal3.h"
+#include "decimal3_parallel.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DECIMAL3_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define DECIMAL3_MMAP 0
+#endif
+
+/**
+ * Loads selected columns of a CSV file into Decimal3 arrays.
+ *
+ * The file is memory-mapped and split into newline-aligned chunks that are
+ * parsed on a Decimal3ThreadPool, straight from the mapped bytes. Fields are
+ * read like Decimal3::from(const char*): surrounding blanks and a leading '+'
+ * are accepted, and a pair of double quotes around the number is removed.
+ * Unlike from(), a field that is not entirely a number is an error, so a
+ * quoted "1,234.50" is one. Failed fields hold ErrorValue and are listed in
+ * Result::errors.
+ *
+ * Delimiters inside double quotes, in any column, do not split the field; ""
+ * inside quotes is an escaped quote. Lines end with "\n" or "\r\n", and
+ * quoted fields can not contain newlines. Empty lines are skipped and take
+ * no row.
+ */
+namespace Decimal3Csv {
+
+    struct Options {
+        char delimiter = ',';
+        /// skip the first line
+        bool header = false;
+    };
+
+    struct Error {
+        /// data row, the index into the loaded arrays
+        size_t row;
+        /// column in the file
+        size_t column;
+        /// invalid_argument for text that is not a number or a missing field,
+        /// result_out_of_range for a number outside the range
+        std::errc ec;
+    };
+
+    struct Result {
+        /// one array per selected column, in the order they were given
+        std::vector<std::vector<Decimal3>> columns;
+        /// parse errors ordered by row and column
+        std::vector<Error> errors;
+        size_t rows = 0;
+        /// set when the file can not be read, or the selected columns are not distinct
+        std::error_code io_error;
+
+        bool ok() const { return !io_error && errors.empty(); }
+    };
+
+    namespace detail {
+
+        /// Chunks are at least this large, so small inputs are parsed by one thread
+        constexpr size_t MinChunkBytes = size_t(1) << 16;
+
+        /// Read-only view of a whole file, memory-mapped where available
+        class MappedFile {
+        public:
+            explicit MappedFile(const char* path) {
+#if DECIMAL3_MMAP
+                int fd = ::open(path, O_RDONLY);
+                if (fd < 0) {
+                    _error = std::error_code(errno, std::generic_category());
+                    return;
+                }
+                struct stat st;
+                if (::fstat(fd, &st) != 0) {
+                    _error = std::error_code(errno, std::generic_category());
+                }
+                else if (st.st_size > 0) {
+                    void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (p == MAP_FAILED) {
+                        _error = std::error_code(errno, std::generic_category());
+                    }
+                    else {
+                        ::madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                        _data = static_cast<const char*>(p);
+                        _size = static_cast<size_t>(st.st_size);
+                    }
+                }
+                ::close(fd);
+#else
+                FILE* fp = std::fopen(path, "rb");
+                if (!fp) {
+                    _error = std::error_code(errno, std::generic_category());
+                    return;
+                }
+                char buf[1 << 16];
+                size_t n;
+                while ((n = std::fread(buf, 1, sizeof(buf), fp)) > 0)
+                    _buffer.insert(_buffer.end(), buf, buf + n);
+                if (std::ferror(fp))
+                    _error = std::make_error_code(std::errc::io_error);
+                std::fclose(fp);
+                _data = _buffer.data();
+                _size = _buffer.size();
+#endif
+            }
+
+            ~MappedFile() {
+#if DECIMAL3_MMAP
+                if (_data)
+                    ::munmap(const_cast<char*>(_data), _size);
+#endif
+            }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const char* data() const { return _data; }
+            size_t size() const { return _size; }
+            std::error_code error() const { return _error; }
+
+        private:
+            const char* _data = nullptr;
+            size_t _size = 0;
+            std::error_code _error;
+#if !DECIMAL3_MMAP
+            std::vector<char> _buffer;
+#endif
+        };
+
+        inline const char* find(const char* first, const char* last, char c) {
+            const void* p = std::memchr(first, c, static_cast<size_t>(last - first));
+            return p ? static_cast<const char*>(p) : last;
+        }
+
+        /// end of the field at first: the next delimiter outside double quotes,
+        /// or last. A quote left open runs to last.
+        inline const char* field_end(const char* first, const char* last, char delimiter) {
+            const char* d = find(first, last, delimiter);
+            // "" closes and reopens the quotes, so it needs no special case
+            for (const char* q = find(first, d, '"'); q != d; q = find(q + 1, d, '"')) {
+                q = find(q + 1, last, '"');
+                if (q == last)
+                    return last;
+                d = find(q + 1, last, delimiter);
+            }
+            return d;
+        }
+
+        /// true for an empty line, of [first, eol) before its '\n'
+        inline bool blank_line(const char* first, const char* eol) {
+            return eol == first || (eol - first == 1 && *first == '\r');
+        }
+
+        inline std::errc parse_field(const char* first, const char* last, int64_t& value) {
+            while (first != last && (*first == ' ' || *first == '\t'))
+                first++;
+            while (last != first && (last[-1] == ' ' || last[-1] == '\t'))
+                last--;
+            if (last - first >= 2 && *first == '"' && last[-1] == '"') {
+                first++;
+                last--;
+            }
+            if (last - first >= 2 && first[0] == '+' && first[1] != '-')
+                first++;
+            auto result = Decimal3::parse_chars_to_internal_long(first, last, value);
+            if (result.ec != std::errc())
+                return result.ec;
+            return result.ptr == last ? std::errc() : std::errc::invalid_argument;
+        }
+
+        inline size_t count_rows(const char* first, const char* last) {
+            size_t rows = 0;
+            for (const char* p = first; p != last;) {
+                const char* eol = find(p, last, '\n');
+                rows += !blank_line(p, eol);
+                p = eol == last ? last : eol + 1;
+            }
+            return rows;
+        }
+
+        /// parses the lines of [first, last) into rows [row, ...) of out
+        inline void parse_chunk(const char* first, const char* last, size_t row,
+                                const std::vector<int>& slot_of,
+                                char delimiter, Decimal3* const* out, std::vector<Error>& errors) {
+            const size_t max_column = slot_of.size() - 1;
+            for (const char* p = first; p != last;) {
+                const char* eol = find(p, last, '\n');
+                const char* next = eol == last ? last : eol + 1;
+                if (blank_line(p, eol)) {
+                    p = next;
+                    continue;
+                }
+                const char* end = eol != p && eol[-1] == '\r' ? eol - 1 : eol;
+                size_t column = 0;
+                for (const char* f = p;; column++) {
+                    const char* d = field_end(f, end, delimiter);
+                    int slot = slot_of[column];
+                    if (slot >= 0) {
+                        int64_t value = Decimal3::ErrorValue;
+                        std::errc ec = parse_field(f, d, value);
+                        if (ec != std::errc()) {
+                            value = Decimal3::ErrorValue;
+                            errors.push_back({ row, column, ec });
+                        }
+                        out[slot][row] = Decimal3(value);
+                    }
+                    if (d == end || column == max_column)
+                        break;
+                    f = d + 1;
+                }
+                // selected columns past the end of a short line
+                for (size_t c = column + 1; c <= max_column; c++) {
+                    if (slot_of[c] >= 0) {
+                        out[slot_of[c]][row] = Decimal3(Decimal3::ErrorValue);
+                        errors.push_back({ row, c, std::errc::invalid_argument });
+                    }
+                }
+                p = next;
+                row++;
+            }
+        }
+    }
+
+    /// @brief parses the CSV text in [data, data + size)
+    inline Result parse(const char* data, size_t size, const std::vector<size_t>& columns,
+                        const Options& options = Options(), Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        Result result;
+        result.columns.resize(columns.size());
+        if (columns.empty())
+            return result;
+
+        size_t max_column = 0;
+        for (size_t c : columns)
+            max_column = c > max_column ? c : max_column;
+        std::vector<int> slot_of(max_column + 1, -1);
+        for (size_t s = 0; s < columns.size(); s++) {
+            if (slot_of[columns[s]] >= 0) {
+                result.io_error = std::make_error_code(std::errc::invalid_argument);
+                return result;
+            }
+            slot_of[columns[s]] = static_cast<int>(s);
+        }
+
+        const char* first = data;
+        const char* last = data + size;
+        if (options.header && first != last) {
+            first = detail::find(first, last, '\n');
+            first = first == last ? last : first + 1;
+        }
+
+        // newline-aligned chunks, a few per thread to even out the load
+        size_t bytes = static_cast<size_t>(last - first);
+        size_t chunks = pool.size() * 4;
+        if (chunks > bytes / detail::MinChunkBytes + 1)
+            chunks = bytes / detail::MinChunkBytes + 1;
+        std::vector<const char*> bounds(chunks + 1, last);
+        bounds[0] = first;
+        for (size_t k = 1; k < chunks; k++) {
+            const char* p = first + bytes / chunks * k;
+            if (p < bounds[k - 1])
+                p = bounds[k - 1];
+            p = detail::find(p, last, '\n');
+            bounds[k] = p == last ? last : p + 1;
+        }
+
+        // count rows first, so every chunk writes straight into the result
+        std::vector<size_t> row_begin(chunks + 1, 0);
+        pool.run(chunks, [&](size_t k) {
+            row_begin[k + 1] = detail::count_rows(bounds[k], bounds[k + 1]);
+        });
+        for (size_t k = 0; k < chunks; k++)
+            row_begin[k + 1] += row_begin[k];
+        result.rows = row_begin[chunks];
+
+        std::vector<Decimal3*> out(columns.size());
+        for (size_t s = 0; s < columns.size(); s++) {
+            result.columns[s].resize(result.rows);
+            out[s] = result.columns[s].data();
+        }
+        std::vector<std::vector<Error>> errors(chunks);
+        pool.run(chunks, [&](size_t k) {
+            detail::parse_chunk(bounds[k], bounds[k + 1], row_begin[k], slot_of,
+                                options.delimiter, out.data(), errors[k]);
+        });
+        for (auto& e : errors)
+            result.errors.insert(result.errors.end(), e.begin(), e.end());
+        return result;
+    }
+
+    /// @brief maps the file at path and parses it
+    inline Result load(const char* path, const std::vector<size_t>& columns,
+                       const Options& options = Options(), Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        detail::MappedFile file(path);
+        if (file.error()) {
+            Result result;
+            result.columns.resize(columns.size());
+            result.io_error = file.error();
+            return result;
+        }
+        return parse(file.data(), file.size(), columns, options, pool);
+    }
+}
+
+#endif // DECIMAL3_CSV_H
@@ -0,0 +1,277 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_DIVISOR_H
+#define DECIMAL3_DIVISOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "decimal3.h"
+#include "decimal3_batch.h"
+#include "decimal3_simd.h"
+
+namespace Decimal3Batch {
+    namespace detail {
+        struct DivisorKernels;
+    }
+}
+
+/**
+ * Division by a divisor that is known ahead of time.
+ *
+ * Decimal3Divisor precomputes a reciprocal of the divisor, so every quotient
+ * is a multiply and a shift instead of a hardware division. The remainder is
+ * recovered from the quotient and rounds it like Decimal3's operator/, so
+ * results are the same as operator/ for every input, ErrorValue included.
+ */
+class Decimal3Divisor {
+public:
+    /// @brief divides by a Decimal3, like operator/
+    static Decimal3Divisor from(Decimal3 divisor) {
+        return Decimal3Divisor(divisor.value(), Decimal3::Params::Factor);
+    }
+
+    /// @brief divides by an integer, like operator/ by Decimal3::from(divisor),
+    /// for divisors past MaxValue as well
+    static Decimal3Divisor from_integer(int64_t divisor) {
+        return Decimal3Divisor(divisor, 1);
+    }
+
+    /// @brief returns a / divisor as an internal value
+    int64_t divide(int64_t a) const {
+        if (a == Decimal3::ErrorValue || _error)
+            return Decimal3::ErrorValue;
+        bool negative = (a < 0) != _negative;
+        uint64_t m = a < 0 ? 0 - static_cast<uint64_t>(a) : static_cast<uint64_t>(a);
+        if (m > _max_numerator)
+            return Decimal3::safe_divide(a, _divisor);
+        // m * _scale < 2^63, the quotient can not overflow
+        uint64_t n = m * _scale;
+        uint64_t q = quotient(n);
+        uint64_t r = n - q * _magnitude;
+        q += Decimal3::rounding_type::round_up(q, r, _magnitude, negative);
+        return negative ? -static_cast<int64_t>(q) : static_cast<int64_t>(q);
+    }
+
+    Decimal3 divide(Decimal3 a) const {
+        return Decimal3(divide(a.value()));
+    }
+
+    /// @brief out[i] = in[i] / divisor. out may alias in.
+    void divide(const int64_t* in, int64_t* out, size_t n) const;
+
+    void divide(const Decimal3* in, Decimal3* out, size_t n) const {
+        divide(Decimal3Batch::detail::raw(in), Decimal3Batch::detail::raw(out), n);
+    }
+
+    /// @brief true when the divisor is zero or ErrorValue; every quotient is then ErrorValue
+    bool error() const { return _error; }
+
+private:
+    Decimal3Divisor(int64_t divisor, uint64_t scale) : _divisor(divisor), _scale(scale) {
+        using Decimal3Detail::uint128;
+        _error = divisor == 0 || (scale != 1 && divisor == Decimal3::ErrorValue);
+        _negative = divisor < 0;
+        _magnitude = divisor < 0 ? 0 - static_cast<uint64_t>(divisor) : static_cast<uint64_t>(divisor);
+        _max_numerator = static_cast<uint64_t>(Decimal3::Params::LongMax) / scale;
+        _reciprocal = _error ? 0.0 : 1.0 / static_cast<double>(_magnitude);
+        if (_error)
+            return;
+
+        // floor(n / d) = mulhi(n, magic) >> shift, or with one more bit of
+        // magic, (((n - t) >> 1) + t) >> shift for t = mulhi(n, magic)
+        int log2 = 63 - __builtin_clzll(_magnitude);
+        _shift = log2;
+        if ((_magnitude & (_magnitude - 1)) == 0) {
+            _magic = 0;
+            return;
+        }
+        uint128 power = static_cast<uint128>(1) << (64 + log2);
+        uint64_t m = static_cast<uint64_t>(power / _magnitude);
+        uint64_t rem = static_cast<uint64_t>(power % _magnitude);
+        if (_magnitude - rem < (uint64_t(1) << log2)) {
+            _magic = m + 1;
+        }
+        else {
+            // m * 2 + 1 rounded up, its 65th bit is given by the add step
+            uint64_t twice_rem = rem + rem;
+            m += m;
+            if (twice_rem >= _magnitude || twice_rem < rem)
+                m += 1;
+            _magic = m + 1;
+            _add = true;
+        }
+    }
+
+    uint64_t quotient(uint64_t n) const {
+        if (_magic == 0)
+            return n >> _shift;
+        uint64_t t = static_cast<uint64_t>((static_cast<Decimal3Detail::uint128>(n) * _magic) >> 64);
+        if (_add)
+            t += (n - t) >> 1;
+        return t >> _shift;
+    }
+
+    int64_t _divisor;
+    /// numerators are m * _scale, Factor for Decimal3 divisors and 1 for integers
+    uint64_t _scale;
+    uint64_t _magnitude = 0;
+    /// largest magnitude whose numerator fits in 63 bits
+    uint64_t _max_numerator = 0;
+    uint64_t _magic = 0;
+    int _shift = 0;
+    bool _add = false;
+    bool _negative = false;
+    bool _error = false;
+    /// 1 / _magnitude, for the SIMD kernels
+    double _reciprocal = 0.0;
+
+    friend struct Decimal3Batch::detail::DivisorKernels;
+};
+
+inline Decimal3 operator/(Decimal3 a, const Decimal3Divisor& divisor) {
+    return divisor.divide(a);
+}
+
+namespace Decimal3Batch {
+
+    namespace detail {
+
+        // The divide kernels handle lanes where the numerator |a| * scale and the
+        // divisor are below 2^51. Both are then exact in a double, and the quotient
+        // from the reciprocal is off by at most one, which the exact remainder
+        // corrects before rounding. Other lanes use the scalar divide().
+        struct DivisorKernels {
+            static constexpr int64_t FastLimit = int64_t(1) << 51;
+#if DECIMAL3_X86_SIMD
+
+            DECIMAL3_TARGET_AVX2
+            static void divide_avx2(const Decimal3Divisor& d, const int64_t* in, int64_t* out, size_t n) {
+                const __m256i zero = _mm256_setzero_si256();
+                const __m256i limit = _mm256_set1_epi64x(static_cast<int64_t>(FastLimit / d._scale));
+                const __m256i sign = _mm256_set1_epi64x(d._negative ? -1 : 0);
+                const __m256i magic_bits = _mm256_set1_epi64x(DoubleMagicBits);
+                const __m256d magic = _mm256_set1_pd(DoubleMagic);
+                const __m256d scale = _mm256_set1_pd(static_cast<double>(d._scale));
+                const __m256d divisor = _mm256_set1_pd(static_cast<double>(d._magnitude));
+                const __m256d reciprocal = _mm256_set1_pd(d._reciprocal);
+                const __m256d zerod = _mm256_setzero_pd();
+                const __m256d one = _mm256_set1_pd(1.0);
+                const __m256i minus_one = _mm256_set1_epi64x(-1);
+                size_t i = 0;
+                for (; i + 4 <= n; i += 4) {
+                    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                    __m256i neg = _mm256_cmpgt_epi64(zero, x);
+                    __m256i m = _mm256_blendv_epi8(x, _mm256_sub_epi64(zero, x), neg);
+                    // ErrorValue stays negative and fails the limit
+                    __m256i fast = _mm256_and_si256(_mm256_cmpgt_epi64(limit, m), _mm256_cmpgt_epi64(m, minus_one));
+
+                    __m256d nd = _mm256_mul_pd(_mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(m, magic_bits)), magic), scale);
+                    __m256d q = _mm256_floor_pd(_mm256_mul_pd(nd, reciprocal));
+                    __m256d r = _mm256_sub_pd(nd, _mm256_mul_pd(q, divisor));
+                    __m256d low = _mm256_cmp_pd(r, zerod, _CMP_LT_OQ);
+                    q = _mm256_sub_pd(q, _mm256_and_pd(low, one));
+                    r = _mm256_add_pd(r, _mm256_and_pd(low, divisor));
+                    __m256d high = _mm256_cmp_pd(r, divisor, _CMP_GE_OQ);
+                    q = _mm256_add_pd(q, _mm256_and_pd(high, one));
+                    r = _mm256_sub_pd(r, _mm256_and_pd(high, divisor));
+                    // half away from zero: 2r >= d
+                    q = _mm256_add_pd(q, _mm256_and_pd(_mm256_cmp_pd(_mm256_add_pd(r, r), divisor, _CMP_GE_OQ), one));
+
+                    __m256i v = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(q, magic)), magic_bits);
+                    __m256i flip = _mm256_xor_si256(neg, sign);
+                    v = _mm256_sub_epi64(_mm256_xor_si256(v, flip), flip);
+
+                    int fast_bits = _mm256_movemask_pd(_mm256_castsi256_pd(fast));
+                    if (fast_bits != 0xF) {
+                        // patch slow lanes before the store, as out may alias in
+                        alignas(32) int64_t tmp[4];
+                        _mm256_store_si256(reinterpret_cast<__m256i*>(tmp), v);
+                        for (int lane = 0; lane < 4; lane++) {
+                            if (!(fast_bits & (1 << lane)))
+                                tmp[lane] = d.divide(in[i + lane]);
+                        }
+                        v = _mm256_load_si256(reinterpret_cast<const __m256i*>(tmp));
+                    }
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+                }
+                for (; i < n; i++)
+                    out[i] = d.divide(in[i]);
+            }
+
+            DECIMAL3_TARGET_AVX512
+            static void divide_avx512(const Decimal3Divisor& d, const int64_t* in, int64_t* out, size_t n) {
+                const __m512i zero = _mm512_setzero_si512();
+                const __m512i limit = _mm512_set1_epi64(static_cast<int64_t>(FastLimit / d._scale));
+                const __m512i magic_bits = _mm512_set1_epi64(DoubleMagicBits);
+                const __m512d magic = _mm512_set1_pd(DoubleMagic);
+                const __m512d scale = _mm512_set1_pd(static_cast<double>(d._scale));
+                const __m512d divisor = _mm512_set1_pd(static_cast<double>(d._magnitude));
+                const __m512d reciprocal = _mm512_set1_pd(d._reciprocal);
+                const __m512d zerod = _mm512_setzero_pd();
+                const __m512d one = _mm512_set1_pd(1.0);
+                for (size_t i = 0; i < n; i += 8) {
+                    __mmask8 k = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+                    __m512i x = _mm512_maskz_loadu_epi64(k, in + i);
+                    __mmask8 neg = _mm512_cmplt_epi64_mask(x, zero);
+                    __m512i m = _mm512_abs_epi64(x);
+                    // ErrorValue stays negative and fails the limit
+                    __mmask8 fast = _mm512_cmplt_epi64_mask(m, limit) & _mm512_cmpge_epi64_mask(m, zero);
+
+                    __m512d nd = _mm512_mul_pd(_mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(m, magic_bits)), magic), scale);
+                    __m512d q = _mm512_roundscale_pd(_mm512_mul_pd(nd, reciprocal), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+                    __m512d r = _mm512_sub_pd(nd, _mm512_mul_pd(q, divisor));
+                    __mmask8 low = _mm512_cmp_pd_mask(r, zerod, _CMP_LT_OQ);
+                    q = _mm512_mask_sub_pd(q, low, q, one);
+                    r = _mm512_mask_add_pd(r, low, r, divisor);
+                    __mmask8 high = _mm512_cmp_pd_mask(r, divisor, _CMP_GE_OQ);
+                    q = _mm512_mask_add_pd(q, high, q, one);
+                    r = _mm512_mask_sub_pd(r, high, r, divisor);
+                    // half away from zero: 2r >= d
+                    q = _mm512_mask_add_pd(q, _mm512_cmp_pd_mask(_mm512_add_pd(r, r), divisor, _CMP_GE_OQ), q, one);
+
+                    __m512i v = _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(q, magic)), magic_bits);
+                    __mmask8 flip = d._negative ? static_cast<__mmask8>(~neg) : neg;
+                    v = _mm512_mask_sub_epi64(v, flip, zero, v);
+
+                    unsigned slow = k & ~fast;
+                    if (slow) {
+                        // patch slow lanes before the store, as out may alias in
+                        alignas(64) int64_t tmp[8];
+                        _mm512_store_si512(tmp, v);
+                        while (slow) {
+                            int lane = __builtin_ctz(slow);
+                            slow &= slow - 1;
+                            tmp[lane] = d.divide(in[i + lane]);
+                        }
+                        v = _mm512_load_si512(tmp);
+                    }
+                    _mm512_mask_storeu_epi64(out + i, k, v);
+                }
+            }
+#endif
+        };
+    }
+}
+
+inline void Decimal3Divisor::divide(const int64_t* in, int64_t* out, size_t n) const {
+    static_assert(std::is_same<Decimal3::rounding_type, DecimalRounding::HalfUp>::value,
+                  "the SIMD kernels round half away from zero");
+    // the kernels need the divisor itself below 2^51 as well
+    bool simd = !_error && _magnitude < static_cast<uint64_t>(Decimal3Batch::detail::DivisorKernels::FastLimit);
+    switch (simd ? Decimal3Simd::active_isa() : Decimal3Simd::Isa::Scalar) {
+#if DECIMAL3_X86_SIMD
+    case Decimal3Simd::Isa::Avx512: return Decimal3Batch::detail::DivisorKernels::divide_avx512(*this, in, out, n);
+    case Decimal3Simd::Isa::Avx2:   return Decimal3Batch::detail::DivisorKernels::divide_avx2(*this, in, out, n);
+#endif
+    default:
+        for (size_t i = 0; i < n; i++)
+            out[i] = divide(in[i]);
+    }
+}
+
+#endif // DECIMAL3_DIVISOR_H
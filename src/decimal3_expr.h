@@ -0,0 +1,288 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_EXPR_H
+#define DECIMAL3_EXPR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "decimal3.h"
+
+/**
+ * Formulas of Decimal3 values evaluated with a single rounding.
+ *
+ * A formula starts from lazy() or col() and keeps the operator syntax:
+ *
+ *     Decimal3 total = lazy(price) * qty * fx + fee - rebate;
+ *     evaluate(col(prices) * col(qtys) * fx + fee, out, n);
+ *
+ * The operators only build a type. Evaluation is exact in 128 bits, each node
+ * at the scale its operands give it (3 per factor of a product), and the sum
+ * is rounded to Decimal3 once, by Decimal3's rounding policy. ErrorValue
+ * operands and 128-bit overflow are collected into one flag and checked once
+ * at the end, so the result is ErrorValue exactly when an operand is, or when
+ * the rounded result or an intermediate does not fit.
+ *
+ * Supported are +, - and * of Decimal3 values and arrays, and unary minus.
+ * Division rounds by itself and is left to Decimal3.
+ *
+ * Only a formula of values converts to Decimal3 by itself. One with a column
+ * has a value per element, so it is read with evaluate(e, i) or
+ * evaluate(e, out, n); `Decimal3 x = col(prices) * qty;` does not compile.
+ */
+namespace Decimal3Expr {
+
+    using Decimal3Detail::int128;
+    using Decimal3Detail::uint128;
+
+    namespace detail {
+
+        constexpr int128 pow10(int n) {
+            int128 p = 1;
+            for (int i = 0; i < n; i++)
+                p *= 10;
+            return p;
+        }
+
+        /// largest scale whose power of ten fits in int128
+        constexpr int MaxScale = 38;
+
+        template <class Node>
+        constexpr int64_t finish(const Node& node, size_t i);
+    }
+
+    /// Base of all nodes. A formula without a column converts to Decimal3.
+    template <class Derived>
+    struct Node {
+        template <class D = Derived, class = std::enable_if_t<!D::has_column>>
+        constexpr operator Decimal3() const {
+            return Decimal3(detail::finish(static_cast<const Derived&>(*this), 0));
+        }
+    };
+
+    /// One Decimal3 value, the same for every element
+    struct Value : Node<Value> {
+        static constexpr int scale = Decimal3::scale;
+        static constexpr bool has_column = false;
+        int64_t value;
+
+        constexpr explicit Value(Decimal3 x) : value(x.value()) {}
+
+        constexpr int128 eval(size_t, bool& error) const {
+            error |= value == Decimal3::ErrorValue;
+            return value;
+        }
+    };
+
+    /// Element i of an array of internal values
+    struct Column : Node<Column> {
+        static constexpr int scale = Decimal3::scale;
+        static constexpr bool has_column = true;
+        const int64_t* values;
+
+        constexpr explicit Column(const int64_t* x) : values(x) {}
+
+        constexpr int128 eval(size_t i, bool& error) const {
+            int64_t x = values[i];
+            error |= x == Decimal3::ErrorValue;
+            return x;
+        }
+    };
+
+    template <class L, class R>
+    struct Add : Node<Add<L, R>> {
+        static constexpr int scale = L::scale > R::scale ? L::scale : R::scale;
+        static constexpr bool has_column = L::has_column || R::has_column;
+        L l;
+        R r;
+
+        constexpr Add(const L& a, const R& b) : l(a), r(b) {}
+
+        constexpr int128 eval(size_t i, bool& error) const {
+            int128 a = align<L>(l.eval(i, error), error);
+            int128 b = align<R>(r.eval(i, error), error);
+            int128 sum = 0;
+            error |= __builtin_add_overflow(a, b, &sum);
+            return sum;
+        }
+
+        template <class N>
+        static constexpr int128 align(int128 x, bool& error) {
+            if constexpr (N::scale == scale) {
+                return x;
+            }
+            else {
+                int128 y = 0;
+                error |= __builtin_mul_overflow(x, detail::pow10(scale - N::scale), &y);
+                return y;
+            }
+        }
+    };
+
+    template <class L, class R>
+    struct Subtract : Node<Subtract<L, R>> {
+        static constexpr int scale = Add<L, R>::scale;
+        static constexpr bool has_column = L::has_column || R::has_column;
+        L l;
+        R r;
+
+        constexpr Subtract(const L& a, const R& b) : l(a), r(b) {}
+
+        constexpr int128 eval(size_t i, bool& error) const {
+            int128 a = Add<L, R>::template align<L>(l.eval(i, error), error);
+            int128 b = Add<L, R>::template align<R>(r.eval(i, error), error);
+            int128 difference = 0;
+            error |= __builtin_sub_overflow(a, b, &difference);
+            return difference;
+        }
+    };
+
+    template <class L, class R>
+    struct Multiply : Node<Multiply<L, R>> {
+        static constexpr int scale = L::scale + R::scale;
+        static_assert(scale <= detail::MaxScale, "too many factors for a 128-bit product");
+        static constexpr bool has_column = L::has_column || R::has_column;
+        L l;
+        R r;
+
+        constexpr Multiply(const L& a, const R& b) : l(a), r(b) {}
+
+        constexpr int128 eval(size_t i, bool& error) const {
+            int128 a = l.eval(i, error);
+            int128 b = r.eval(i, error);
+            int128 product = 0;
+            error |= __builtin_mul_overflow(a, b, &product);
+            return product;
+        }
+    };
+
+    template <class E>
+    struct Negate : Node<Negate<E>> {
+        static constexpr int scale = E::scale;
+        static constexpr bool has_column = E::has_column;
+        E e;
+
+        constexpr explicit Negate(const E& x) : e(x) {}
+
+        constexpr int128 eval(size_t i, bool& error) const {
+            // negated in unsigned, as the value may have wrapped already
+            uint128 x = static_cast<uint128>(e.eval(i, error));
+            error |= x == static_cast<uint128>(1) << 127;
+            return static_cast<int128>(0 - x);
+        }
+    };
+
+    namespace detail {
+
+        template <class T>
+        struct is_node : std::is_base_of<Node<T>, T> {};
+
+        /// node for an operand: nodes as they are, Decimal3 as a Value
+        template <class T, class = void>
+        struct operand {};
+        template <class T>
+        struct operand<T, std::enable_if_t<is_node<T>::value>> {
+            using type = T;
+            static constexpr const T& make(const T& x) { return x; }
+        };
+        template <>
+        struct operand<Decimal3> {
+            using type = Value;
+            static constexpr Value make(Decimal3 x) { return Value(x); }
+        };
+
+        /// one side a node, the other a node or Decimal3
+        template <class L, class R>
+        using enable_binary = std::enable_if_t<
+            (is_node<L>::value || is_node<R>::value)
+            && (is_node<L>::value || std::is_same<L, Decimal3>::value)
+            && (is_node<R>::value || std::is_same<R, Decimal3>::value)>;
+
+        template <class Node>
+        constexpr int64_t finish(const Node& node, size_t i) {
+            constexpr int shift = Node::scale - Decimal3::scale;
+            bool error = false;
+            int128 x = node.eval(i, error);
+            bool negative = x < 0;
+            uint128 m = negative ? 0 - static_cast<uint128>(x) : static_cast<uint128>(x);
+            if constexpr (shift > 0) {
+                using Rounding = Decimal3::rounding_type;
+                constexpr uint128 d = static_cast<uint128>(pow10(shift));
+                if constexpr (shift <= 19) {
+                    // constant 64-bit divisions compile to a multiply
+                    if ((m >> 64) == 0)
+                        m = Decimal3Detail::round_divide<Rounding>(static_cast<uint64_t>(m), static_cast<uint64_t>(d), negative);
+                    else
+                        m = Decimal3Detail::round_divide<Rounding>(m, d, negative);
+                }
+                else {
+                    m = Decimal3Detail::round_divide<Rounding>(m, d, negative);
+                }
+            }
+            else if constexpr (shift < 0) {
+                error |= __builtin_mul_overflow(m, static_cast<uint128>(pow10(-shift)), &m);
+            }
+            error |= m > static_cast<uint128>(Decimal3::Params::LongMax);
+            int64_t q = static_cast<int64_t>(static_cast<uint64_t>(m));
+            return error ? Decimal3::ErrorValue : negative ? -q : q;
+        }
+    }
+
+    /// @brief starts a formula from one value
+    constexpr Value lazy(Decimal3 x) {
+        return Value(x);
+    }
+
+    /// @brief starts a formula from an array, evaluated element-wise
+    constexpr Column col(const int64_t* values) {
+        return Column(values);
+    }
+
+    inline Column col(const Decimal3* values) {
+        return Column(reinterpret_cast<const int64_t*>(values));
+    }
+
+    template <class L, class R, class = detail::enable_binary<L, R>>
+    constexpr Add<typename detail::operand<L>::type, typename detail::operand<R>::type> operator+(const L& a, const R& b) {
+        return { detail::operand<L>::make(a), detail::operand<R>::make(b) };
+    }
+
+    template <class L, class R, class = detail::enable_binary<L, R>>
+    constexpr Subtract<typename detail::operand<L>::type, typename detail::operand<R>::type> operator-(const L& a, const R& b) {
+        return { detail::operand<L>::make(a), detail::operand<R>::make(b) };
+    }
+
+    template <class L, class R, class = detail::enable_binary<L, R>>
+    constexpr Multiply<typename detail::operand<L>::type, typename detail::operand<R>::type> operator*(const L& a, const R& b) {
+        return { detail::operand<L>::make(a), detail::operand<R>::make(b) };
+    }
+
+    template <class E, class = std::enable_if_t<detail::is_node<E>::value>>
+    constexpr Negate<E> operator-(const E& e) {
+        return Negate<E>(e);
+    }
+
+    /// @brief evaluates element i of a formula, rounding once
+    template <class E, class = std::enable_if_t<detail::is_node<E>::value>>
+    constexpr Decimal3 evaluate(const E& e, size_t i = 0) {
+        return Decimal3(detail::finish(e, i));
+    }
+
+    /// @brief out[i] = element i of the formula, for i < n. out may alias a column.
+    template <class E, class = std::enable_if_t<detail::is_node<E>::value>>
+    void evaluate(const E& e, int64_t* out, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            out[i] = detail::finish(e, i);
+    }
+
+    template <class E, class = std::enable_if_t<detail::is_node<E>::value>>
+    void evaluate(const E& e, Decimal3* out, size_t n) {
+        evaluate(e, reinterpret_cast<int64_t*>(out), n);
+    }
+}
+
+#endif // DECIMAL3_EXPR_H
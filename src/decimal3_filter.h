@@ -0,0 +1,420 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_FILTER_H
+#define DECIMAL3_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "decimal3.h"
+#include "decimal3_batch.h"
+#include "decimal3_simd.h"
+
+/**
+ * Predicate scans over arrays, such as `lo <= price <= hi` or `qty > 0`.
+ *
+ * A scan compares every element with constants or with the element of
+ * another array, and writes the matches either as a bitmap (bit i of word
+ * i / 64 for element i, bits past n cleared, like Decimal3Column's validity)
+ * or as a selection vector of ascending indices. Both return the number of
+ * matches. compact() and gather() then apply a bitmap or a selection.
+ *
+ * ErrorValue never matches, on either side of a comparison: it is neither
+ * below, above, equal to nor different from anything.
+ */
+namespace Decimal3Batch {
+
+    enum class Compare {
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+    };
+
+    namespace detail {
+
+        /// lo <= x <= hi, with LongMin <= lo <= hi, so ErrorValue is out of range
+        struct Between {
+            int64_t lo;
+            uint64_t span;
+
+            Between(int64_t low, int64_t high)
+                : lo(low), span(static_cast<uint64_t>(high) - static_cast<uint64_t>(low)) {}
+
+            bool scalar(int64_t x, int64_t) const {
+                return static_cast<uint64_t>(x) - static_cast<uint64_t>(lo) <= span;
+            }
+
+#if DECIMAL3_X86_SIMD
+            DECIMAL3_TARGET_AVX2
+            __m256i avx2(__m256i x, __m256i) const {
+                // unsigned compare by flipping the sign bits
+                const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+                __m256i d = _mm256_xor_si256(_mm256_sub_epi64(x, _mm256_set1_epi64x(lo)), sign);
+                __m256i outside = _mm256_cmpgt_epi64(d, _mm256_set1_epi64x(static_cast<int64_t>(span ^ (1ULL << 63))));
+                return _mm256_xor_si256(outside, _mm256_set1_epi64x(-1));
+            }
+
+            DECIMAL3_TARGET_AVX512
+            __mmask8 avx512(__m512i x, __m512i) const {
+                __m512i d = _mm512_sub_epi64(x, _mm512_set1_epi64(lo));
+                return _mm512_cmple_epu64_mask(d, _mm512_set1_epi64(static_cast<int64_t>(span)));
+            }
+#endif
+        };
+
+        /// x op y, where neither is ErrorValue
+        template <Compare Op>
+        struct Comparison {
+            bool scalar(int64_t x, int64_t y) const {
+                bool valid = x != Decimal3::ErrorValue && y != Decimal3::ErrorValue;
+                switch (Op) {
+                case Compare::Less:         return valid && x < y;
+                case Compare::LessEqual:    return valid && x <= y;
+                case Compare::Greater:      return valid && x > y;
+                case Compare::GreaterEqual: return valid && x >= y;
+                case Compare::Equal:        return valid && x == y;
+                default:                    return valid && x != y;
+                }
+            }
+
+#if DECIMAL3_X86_SIMD
+            DECIMAL3_TARGET_AVX2
+            __m256i avx2(__m256i x, __m256i y) const {
+                const __m256i err = _mm256_set1_epi64x(Decimal3::ErrorValue);
+                __m256i invalid = _mm256_or_si256(_mm256_cmpeq_epi64(x, err), _mm256_cmpeq_epi64(y, err));
+                // the negated compares drop invalid lanes with the same not
+                switch (Op) {
+                case Compare::Less:         return _mm256_andnot_si256(invalid, _mm256_cmpgt_epi64(y, x));
+                case Compare::LessEqual:    return _mm256_xor_si256(_mm256_or_si256(invalid, _mm256_cmpgt_epi64(x, y)), _mm256_set1_epi64x(-1));
+                case Compare::Greater:      return _mm256_andnot_si256(invalid, _mm256_cmpgt_epi64(x, y));
+                case Compare::GreaterEqual: return _mm256_xor_si256(_mm256_or_si256(invalid, _mm256_cmpgt_epi64(y, x)), _mm256_set1_epi64x(-1));
+                case Compare::Equal:        return _mm256_andnot_si256(invalid, _mm256_cmpeq_epi64(x, y));
+                default:                    return _mm256_xor_si256(_mm256_or_si256(invalid, _mm256_cmpeq_epi64(x, y)), _mm256_set1_epi64x(-1));
+                }
+            }
+
+            DECIMAL3_TARGET_AVX512
+            __mmask8 avx512(__m512i x, __m512i y) const {
+                const __m512i err = _mm512_set1_epi64(Decimal3::ErrorValue);
+                __mmask8 valid = _mm512_cmpneq_epi64_mask(x, err) & _mm512_cmpneq_epi64_mask(y, err);
+                switch (Op) {
+                case Compare::Less:         return _mm512_mask_cmplt_epi64_mask(valid, x, y);
+                case Compare::LessEqual:    return _mm512_mask_cmple_epi64_mask(valid, x, y);
+                case Compare::Greater:      return _mm512_mask_cmpgt_epi64_mask(valid, x, y);
+                case Compare::GreaterEqual: return _mm512_mask_cmpge_epi64_mask(valid, x, y);
+                case Compare::Equal:        return _mm512_mask_cmpeq_epi64_mask(valid, x, y);
+                default:                    return _mm512_mask_cmpneq_epi64_mask(valid, x, y);
+                }
+            }
+#endif
+        };
+
+        // The match kernels return the bits of up to 64 elements. b is a
+        // single value when Broadcast is true.
+
+        template <bool Broadcast, class Pred>
+        inline uint64_t match_scalar(const Pred& p, const int64_t* a, const int64_t* b, size_t count) {
+            uint64_t word = 0;
+            for (size_t j = 0; j < count; j++)
+                word |= static_cast<uint64_t>(p.scalar(a[j], Broadcast ? b[0] : b[j])) << j;
+            return word;
+        }
+
+#if DECIMAL3_X86_SIMD
+        template <bool Broadcast, class Pred>
+        DECIMAL3_TARGET_AVX2
+        inline uint64_t match_avx2(const Pred& p, const int64_t* a, const int64_t* b, size_t count) {
+            const __m256i yb = _mm256_set1_epi64x(b[0]);
+            uint64_t word = 0;
+            size_t j = 0;
+            for (; j + 4 <= count; j += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + j));
+                __m256i y = Broadcast ? yb : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+                uint64_t bits = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(p.avx2(x, y))));
+                word |= bits << j;
+            }
+            if (j < count)
+                word |= match_scalar<Broadcast>(p, a + j, Broadcast ? b : b + j, count - j) << j;
+            return word;
+        }
+
+        template <bool Broadcast, class Pred>
+        DECIMAL3_TARGET_AVX512
+        inline uint64_t match_avx512(const Pred& p, const int64_t* a, const int64_t* b, size_t count) {
+            const __m512i yb = _mm512_set1_epi64(b[0]);
+            uint64_t word = 0;
+            if (count == 64) {
+                // a fixed trip count, unrolled without masks
+                for (size_t j = 0; j < 64; j += 8) {
+                    __m512i x = _mm512_loadu_si512(a + j);
+                    __m512i y = Broadcast ? yb : _mm512_loadu_si512(b + j);
+                    word |= static_cast<uint64_t>(p.avx512(x, y)) << j;
+                }
+                return word;
+            }
+            for (size_t j = 0; j < count; j += 8) {
+                __mmask8 m = count - j >= 8 ? 0xFF : static_cast<__mmask8>((1u << (count - j)) - 1);
+                __m512i x = _mm512_maskz_loadu_epi64(m, a + j);
+                __m512i y = Broadcast ? yb : _mm512_maskz_loadu_epi64(m, b + j);
+                word |= static_cast<uint64_t>(p.avx512(x, y) & m) << j;
+            }
+            return word;
+        }
+#endif
+
+        template <bool Broadcast, class Pred>
+        inline uint64_t match(Decimal3Simd::Isa isa, const Pred& p, const int64_t* a, const int64_t* b, size_t count) {
+            switch (isa) {
+#if DECIMAL3_X86_SIMD
+            case Decimal3Simd::Isa::Avx512: return match_avx512<Broadcast>(p, a, b, count);
+            case Decimal3Simd::Isa::Avx2:   return match_avx2<Broadcast>(p, a, b, count);
+#endif
+            default: return match_scalar<Broadcast>(p, a, b, count);
+            }
+        }
+
+        /// writes the indices of the bits set in word, plus base, from index[count]
+        inline size_t expand(uint64_t word, size_t base, size_t* index, size_t count) {
+            while (word != 0) {
+                index[count++] = base + static_cast<size_t>(__builtin_ctzll(word));
+                word &= word - 1;
+            }
+            return count;
+        }
+
+        template <bool Broadcast, class Pred>
+        inline size_t filter(const Pred& p, const int64_t* a, const int64_t* b, size_t n, uint64_t* bitmap) {
+            Decimal3Simd::Isa isa = Decimal3Simd::active_isa();
+            size_t count = 0;
+            for (size_t i = 0; i < n; i += 64) {
+                uint64_t word = match<Broadcast>(isa, p, a + i, Broadcast ? b : b + i, n - i < 64 ? n - i : 64);
+                bitmap[i / 64] = word;
+                count += static_cast<size_t>(__builtin_popcountll(word));
+            }
+            return count;
+        }
+
+        template <bool Broadcast, class Pred>
+        inline size_t select(const Pred& p, const int64_t* a, const int64_t* b, size_t n, size_t* index) {
+            Decimal3Simd::Isa isa = Decimal3Simd::active_isa();
+            size_t count = 0;
+            for (size_t i = 0; i < n; i += 64)
+                count = expand(match<Broadcast>(isa, p, a + i, Broadcast ? b : b + i, n - i < 64 ? n - i : 64), i, index, count);
+            return count;
+        }
+
+        template <class Scan>
+        inline size_t with_comparison(Compare op, Scan scan) {
+            switch (op) {
+            case Compare::Less:         return scan(Comparison<Compare::Less>());
+            case Compare::LessEqual:    return scan(Comparison<Compare::LessEqual>());
+            case Compare::Greater:      return scan(Comparison<Compare::Greater>());
+            case Compare::GreaterEqual: return scan(Comparison<Compare::GreaterEqual>());
+            case Compare::Equal:        return scan(Comparison<Compare::Equal>());
+            default:                    return scan(Comparison<Compare::NotEqual>());
+            }
+        }
+
+        /// runs scan with the predicate for x op k, a range where one is
+        template <class Scan>
+        inline size_t with_constant(Compare op, int64_t k, Scan scan) {
+            const int64_t lo = Decimal3::Params::LongMin;
+            const int64_t hi = Decimal3::Params::LongMax;
+            bool valid = k != Decimal3::ErrorValue;
+            switch (op) {
+            case Compare::Less:         if (k > lo) return scan(Between(lo, k - 1)); break;
+            case Compare::LessEqual:    if (valid) return scan(Between(lo, k)); break;
+            case Compare::Greater:      if (valid && k < hi) return scan(Between(k + 1, hi)); break;
+            case Compare::GreaterEqual: if (valid) return scan(Between(k, hi)); break;
+            case Compare::Equal:        if (valid) return scan(Between(k, k)); break;
+            default: break;
+            }
+            return with_comparison(op, scan);
+        }
+
+        inline size_t clear_bitmap(uint64_t* bitmap, size_t n) {
+            for (size_t w = 0; w < (n + 63) / 64; w++)
+                bitmap[w] = 0;
+            return 0;
+        }
+
+        inline size_t compact_scalar(const int64_t* values, const uint64_t* bitmap, size_t n, int64_t* out) {
+            size_t count = 0;
+            for (size_t i = 0; i < n; i += 64) {
+                uint64_t word = bitmap[i / 64];
+                if (n - i < 64)
+                    word &= (1ULL << (n - i)) - 1;
+                while (word != 0) {
+                    out[count++] = values[i + static_cast<size_t>(__builtin_ctzll(word))];
+                    word &= word - 1;
+                }
+            }
+            return count;
+        }
+
+        inline void gather_scalar(const int64_t* values, const size_t* index, size_t count, int64_t* out) {
+            for (size_t j = 0; j < count; j++)
+                out[j] = values[index[j]];
+        }
+
+#if DECIMAL3_X86_SIMD
+        DECIMAL3_TARGET_AVX512
+        inline size_t compact_avx512(const int64_t* values, const uint64_t* bitmap, size_t n, int64_t* out) {
+            size_t count = 0;
+            for (size_t i = 0; i < n; i += 64) {
+                uint64_t word = bitmap[i / 64];
+                if (n - i < 64)
+                    word &= (1ULL << (n - i)) - 1;
+                for (size_t j = 0; word != 0; j += 8, word >>= 8) {
+                    __mmask8 m = static_cast<__mmask8>(word);
+                    if (m == 0)
+                        continue;
+                    // masked lanes are not read, so the load stops at n
+                    __m512i x = _mm512_maskz_loadu_epi64(m, values + i + j);
+                    _mm512_mask_compressstoreu_epi64(out + count, m, x);
+                    count += static_cast<size_t>(__builtin_popcount(m));
+                }
+            }
+            return count;
+        }
+
+        DECIMAL3_TARGET_AVX2
+        inline void gather_avx2(const int64_t* values, const size_t* index, size_t count, int64_t* out) {
+            const long long* base = reinterpret_cast<const long long*>(values);
+            size_t j = 0;
+            for (; j + 4 <= count; j += 4) {
+                __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index + j));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + j), _mm256_i64gather_epi64(base, idx, 8));
+            }
+            gather_scalar(values, index + j, count - j, out + j);
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline void gather_avx512(const int64_t* values, const size_t* index, size_t count, int64_t* out) {
+            for (size_t j = 0; j < count; j += 8) {
+                __mmask8 m = count - j >= 8 ? 0xFF : static_cast<__mmask8>((1u << (count - j)) - 1);
+                __m512i idx = _mm512_maskz_loadu_epi64(m, index + j);
+                __m512i x = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), m, idx, values, 8);
+                _mm512_mask_storeu_epi64(out + j, m, x);
+            }
+        }
+#endif
+    }
+
+    /// @brief sets bit i of bitmap when lo <= values[i] <= hi. bitmap needs (n + 63) / 64 words.
+    inline size_t filter_between(const int64_t* values, size_t n, int64_t lo, int64_t hi, uint64_t* bitmap) {
+        lo = lo < Decimal3::Params::LongMin ? Decimal3::Params::LongMin : lo;
+        if (lo > hi)
+            return detail::clear_bitmap(bitmap, n);
+        return detail::filter<true>(detail::Between(lo, hi), values, &lo, n, bitmap);
+    }
+
+    /// @brief sets bit i of bitmap when values[i] op k
+    inline size_t filter(const int64_t* values, size_t n, Compare op, int64_t k, uint64_t* bitmap) {
+        return detail::with_constant(op, k, [&](const auto& p) {
+            return detail::filter<true>(p, values, &k, n, bitmap);
+        });
+    }
+
+    /// @brief sets bit i of bitmap when a[i] op b[i]
+    inline size_t filter(const int64_t* a, const int64_t* b, size_t n, Compare op, uint64_t* bitmap) {
+        return detail::with_comparison(op, [&](const auto& p) {
+            return detail::filter<false>(p, a, b, n, bitmap);
+        });
+    }
+
+    /// @brief writes the indices i where lo <= values[i] <= hi to index, which needs n elements
+    inline size_t select_between(const int64_t* values, size_t n, int64_t lo, int64_t hi, size_t* index) {
+        lo = lo < Decimal3::Params::LongMin ? Decimal3::Params::LongMin : lo;
+        if (lo > hi)
+            return 0;
+        return detail::select<true>(detail::Between(lo, hi), values, &lo, n, index);
+    }
+
+    /// @brief writes the indices i where values[i] op k to index
+    inline size_t select(const int64_t* values, size_t n, Compare op, int64_t k, size_t* index) {
+        return detail::with_constant(op, k, [&](const auto& p) {
+            return detail::select<true>(p, values, &k, n, index);
+        });
+    }
+
+    /// @brief writes the indices i where a[i] op b[i] to index
+    inline size_t select(const int64_t* a, const int64_t* b, size_t n, Compare op, size_t* index) {
+        return detail::with_comparison(op, [&](const auto& p) {
+            return detail::select<false>(p, a, b, n, index);
+        });
+    }
+
+    /// @brief writes the indices of the bits set in the first n bits of bitmap to index
+    inline size_t to_selection(const uint64_t* bitmap, size_t n, size_t* index) {
+        size_t count = 0;
+        for (size_t i = 0; i < n; i += 64) {
+            uint64_t word = bitmap[i / 64];
+            if (n - i < 64)
+                word &= (1ULL << (n - i)) - 1;
+            count = detail::expand(word, i, index, count);
+        }
+        return count;
+    }
+
+    /// @brief writes values[i] for each bit i set in bitmap, in order, to out
+    inline size_t compact(const int64_t* values, const uint64_t* bitmap, size_t n, int64_t* out) {
+        switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+        case Decimal3Simd::Isa::Avx512: return detail::compact_avx512(values, bitmap, n, out);
+#endif
+        default: return detail::compact_scalar(values, bitmap, n, out);
+        }
+    }
+
+    /// @brief out[j] = values[index[j]], for j < count
+    inline void gather(const int64_t* values, const size_t* index, size_t count, int64_t* out) {
+        switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+        case Decimal3Simd::Isa::Avx512: return detail::gather_avx512(values, index, count, out);
+        case Decimal3Simd::Isa::Avx2:   return detail::gather_avx2(values, index, count, out);
+#endif
+        default: return detail::gather_scalar(values, index, count, out);
+        }
+    }
+
+    inline size_t filter_between(const Decimal3* values, size_t n, Decimal3 lo, Decimal3 hi, uint64_t* bitmap) {
+        return filter_between(detail::raw(values), n, lo.value(), hi.value(), bitmap);
+    }
+
+    inline size_t filter(const Decimal3* values, size_t n, Compare op, Decimal3 k, uint64_t* bitmap) {
+        return filter(detail::raw(values), n, op, k.value(), bitmap);
+    }
+
+    inline size_t filter(const Decimal3* a, const Decimal3* b, size_t n, Compare op, uint64_t* bitmap) {
+        return filter(detail::raw(a), detail::raw(b), n, op, bitmap);
+    }
+
+    inline size_t select_between(const Decimal3* values, size_t n, Decimal3 lo, Decimal3 hi, size_t* index) {
+        return select_between(detail::raw(values), n, lo.value(), hi.value(), index);
+    }
+
+    inline size_t select(const Decimal3* values, size_t n, Compare op, Decimal3 k, size_t* index) {
+        return select(detail::raw(values), n, op, k.value(), index);
+    }
+
+    inline size_t select(const Decimal3* a, const Decimal3* b, size_t n, Compare op, size_t* index) {
+        return select(detail::raw(a), detail::raw(b), n, op, index);
+    }
+
+    inline size_t compact(const Decimal3* values, const uint64_t* bitmap, size_t n, Decimal3* out) {
+        return compact(detail::raw(values), bitmap, n, detail::raw(out));
+    }
+
+    inline void gather(const Decimal3* values, const size_t* index, size_t count, Decimal3* out) {
+        gather(detail::raw(values), index, count, detail::raw(out));
+    }
+}
+
+#endif // DECIMAL3_FILTER_H
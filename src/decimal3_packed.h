@@ -0,0 +1,358 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_PACKED_H
+#define DECIMAL3_PACKED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "decimal3.h"
+#include "decimal3_batch.h"
+#include "decimal3_simd.h"
+
+namespace Decimal3Batch {
+
+    namespace detail {
+
+        /// One block of a Decimal3PackedColumn
+        struct PackedBlock {
+            /// value of code 0, or of code 1 when the block has errors
+            int64_t base;
+            /// first word of the codes
+            size_t offset;
+            /// bits per code, 0 to 64
+            int width;
+            /// code 0 is ErrorValue
+            bool has_errors;
+        };
+
+        constexpr uint64_t code_mask(int width) {
+            return width == 64 ? ~0ULL : (1ULL << width) - 1;
+        }
+
+        /// out[j] = code j for j < n, or the value it stands for when Decode
+        template <bool Decode>
+        inline void unpack_scalar(const uint64_t* words, const PackedBlock& block, uint64_t* out, size_t n) {
+            const uint64_t mask = code_mask(block.width);
+            for (size_t j = 0; j < n; j++) {
+                size_t bit = j * static_cast<size_t>(block.width);
+                size_t shift = bit % 64;
+                uint64_t code = words[bit / 64] >> shift;
+                if (shift != 0)
+                    code |= words[bit / 64 + 1] << (64 - shift);
+                code &= mask;
+                if (Decode) {
+                    bool error = block.has_errors && code == 0;
+                    code = error ? static_cast<uint64_t>(Decimal3::ErrorValue) : static_cast<uint64_t>(block.base) + code;
+                }
+                out[j] = code;
+            }
+        }
+
+#if DECIMAL3_X86_SIMD
+        // The unpack kernels gather the two words holding each code and
+        // shift them together. Variable shifts by 64 give zero, so codes
+        // that start on a word boundary need no special case. n is a
+        // multiple of 8 and the codes are followed by at least one word.
+
+        template <bool Decode>
+        DECIMAL3_TARGET_AVX2
+        inline void unpack_avx2(const uint64_t* words, const PackedBlock& block, uint64_t* out, size_t n) {
+            const long long* base_addr = reinterpret_cast<const long long*>(words);
+            const __m256i mask = _mm256_set1_epi64x(static_cast<int64_t>(code_mask(block.width)));
+            const __m256i sixty_four = _mm256_set1_epi64x(64);
+            const __m256i k63 = _mm256_set1_epi64x(63);
+            const __m256i one = _mm256_set1_epi64x(1);
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i base = _mm256_set1_epi64x(block.base);
+            const __m256i err = _mm256_set1_epi64x(Decimal3::ErrorValue);
+            const __m256i has_errors = _mm256_set1_epi64x(block.has_errors ? -1 : 0);
+            const int64_t w = block.width;
+            const __m256i step = _mm256_set1_epi64x(4 * w);
+            __m256i bit = _mm256_set_epi64x(3 * w, 2 * w, w, 0);
+            for (size_t j = 0; j < n; j += 4) {
+                __m256i index = _mm256_srli_epi64(bit, 6);
+                __m256i shift = _mm256_and_si256(bit, k63);
+                __m256i lo = _mm256_i64gather_epi64(base_addr, index, 8);
+                __m256i hi = _mm256_i64gather_epi64(base_addr, _mm256_add_epi64(index, one), 8);
+                __m256i code = _mm256_or_si256(_mm256_srlv_epi64(lo, shift), _mm256_sllv_epi64(hi, _mm256_sub_epi64(sixty_four, shift)));
+                code = _mm256_and_si256(code, mask);
+                if (Decode) {
+                    __m256i error = _mm256_and_si256(has_errors, _mm256_cmpeq_epi64(code, zero));
+                    code = _mm256_blendv_epi8(_mm256_add_epi64(base, code), err, error);
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + j), code);
+                bit = _mm256_add_epi64(bit, step);
+            }
+        }
+
+        template <bool Decode>
+        DECIMAL3_TARGET_AVX512
+        inline void unpack_avx512(const uint64_t* words, const PackedBlock& block, uint64_t* out, size_t n) {
+            const __m512i mask = _mm512_set1_epi64(static_cast<int64_t>(code_mask(block.width)));
+            const __m512i sixty_four = _mm512_set1_epi64(64);
+            const __m512i k63 = _mm512_set1_epi64(63);
+            const __m512i one = _mm512_set1_epi64(1);
+            const __m512i zero = _mm512_setzero_si512();
+            const __m512i base = _mm512_set1_epi64(block.base);
+            const __m512i err = _mm512_set1_epi64(Decimal3::ErrorValue);
+            const int64_t w = block.width;
+            const __m512i step = _mm512_set1_epi64(8 * w);
+            __m512i bit = _mm512_set_epi64(7 * w, 6 * w, 5 * w, 4 * w, 3 * w, 2 * w, w, 0);
+            for (size_t j = 0; j < n; j += 8) {
+                __m512i index = _mm512_srli_epi64(bit, 6);
+                __m512i shift = _mm512_and_si512(bit, k63);
+                __m512i lo = _mm512_i64gather_epi64(index, words, 8);
+                __m512i hi = _mm512_i64gather_epi64(_mm512_add_epi64(index, one), words, 8);
+                __m512i code = _mm512_or_si512(_mm512_srlv_epi64(lo, shift), _mm512_sllv_epi64(hi, _mm512_sub_epi64(sixty_four, shift)));
+                code = _mm512_and_si512(code, mask);
+                if (Decode) {
+                    __mmask8 error = block.has_errors ? _mm512_cmpeq_epi64_mask(code, zero) : 0;
+                    code = _mm512_mask_blend_epi64(error, _mm512_add_epi64(base, code), err);
+                }
+                _mm512_storeu_si512(out + j, code);
+                bit = _mm512_add_epi64(bit, step);
+            }
+        }
+#endif
+
+        /// unpacks the first n codes of a block, n <= BlockRows
+        template <bool Decode>
+        inline void unpack(const uint64_t* words, const PackedBlock& block, uint64_t* out, size_t n) {
+            if (block.width == 0) {
+                uint64_t v = Decode ? static_cast<uint64_t>(block.has_errors ? Decimal3::ErrorValue : block.base) : 0;
+                for (size_t j = 0; j < n; j++)
+                    out[j] = v;
+                return;
+            }
+            // whole vectors may run past n, into the codes of the next block
+            size_t vectors = (n + 7) / 8 * 8;
+            switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+            case Decimal3Simd::Isa::Avx512: return unpack_avx512<Decode>(words, block, out, vectors);
+            case Decimal3Simd::Isa::Avx2:   return unpack_avx2<Decode>(words, block, out, vectors);
+#endif
+            default: return unpack_scalar<Decode>(words, block, out, n);
+            }
+        }
+    }
+}
+
+/**
+ * Immutable, compressed column of Decimal3 values, for data in a narrow
+ * range such as the prices of one instrument.
+ *
+ * Rows are stored in blocks of BlockRows. Each block keeps its smallest value
+ * as a base, and every row as the offset from it in as few bits as the range
+ * of the block needs, so a block of equal values takes no bits at all. In a
+ * block that holds ErrorValue, the base is one below the smallest value and
+ * offset 0 stands for ErrorValue, so errors round-trip. get() is O(1), and the
+ * scans work block by block on the offsets, skipping blocks by their range.
+ */
+class Decimal3PackedColumn {
+public:
+    /// Rows per block
+    static constexpr size_t BlockRows = 128;
+
+    Decimal3PackedColumn() = default;
+
+    static Decimal3PackedColumn from_vector(const std::vector<Decimal3>& values) {
+        return from_array(values.data(), values.size());
+    }
+
+    static Decimal3PackedColumn from_array(const Decimal3* values, size_t n) {
+        Decimal3PackedColumn column;
+        column._size = n;
+        column._blocks.reserve((n + BlockRows - 1) / BlockRows);
+        const int64_t* raw = Decimal3Batch::detail::raw(values);
+        for (size_t row = 0; row < n; row += BlockRows)
+            column.pack_block(raw + row, n - row < BlockRows ? n - row : BlockRows);
+        // the unpack kernels read one word past the codes
+        column._words.push_back(0);
+        return column;
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    size_t block_count() const { return _blocks.size(); }
+
+    /// @brief bytes used by the codes and the block headers
+    size_t memory_bytes() const {
+        return _words.size() * sizeof(uint64_t) + _blocks.size() * sizeof(Decimal3Batch::detail::PackedBlock);
+    }
+
+    /// @brief returns row i
+    Decimal3 get(size_t i) const {
+        const Decimal3Batch::detail::PackedBlock& block = _blocks[i / BlockRows];
+        size_t bit = (i % BlockRows) * static_cast<size_t>(block.width);
+        const uint64_t* w = _words.data() + block.offset + bit / 64;
+        size_t shift = bit % 64;
+        // the second word only matters when the code crosses into it
+        uint64_t code = shift == 0 ? w[0] : (w[0] >> shift) | (w[1] << (64 - shift));
+        code &= Decimal3Batch::detail::code_mask(block.width);
+        if (block.has_errors && code == 0)
+            return Decimal3(Decimal3::ErrorValue);
+        return Decimal3(static_cast<int64_t>(static_cast<uint64_t>(block.base) + code));
+    }
+
+    Decimal3 operator[](size_t i) const {
+        return get(i);
+    }
+
+    /// @brief writes the rows of block b to out, which needs BlockRows elements,
+    /// and returns how many there are
+    size_t decode_block(size_t b, int64_t* out) const {
+        size_t rows = block_rows(b);
+        if (rows == BlockRows) {
+            unpack<true>(b, reinterpret_cast<uint64_t*>(out), rows);
+        }
+        else {
+            uint64_t tmp[BlockRows];
+            unpack<true>(b, tmp, rows);
+            for (size_t j = 0; j < rows; j++)
+                out[j] = static_cast<int64_t>(tmp[j]);
+        }
+        return rows;
+    }
+
+    /// @brief writes all size() rows to out
+    void decode(int64_t* out) const {
+        for (size_t b = 0; b < _blocks.size(); b++)
+            decode_block(b, out + b * BlockRows);
+    }
+
+    void decode(Decimal3* out) const {
+        decode(Decimal3Batch::detail::raw(out));
+    }
+
+    std::vector<Decimal3> to_vector() const {
+        std::vector<Decimal3> out(_size);
+        decode(out.data());
+        return out;
+    }
+
+    /// @brief number of rows with lo <= value <= hi. ErrorValue rows never count.
+    size_t count_between(Decimal3 lo, Decimal3 hi) const {
+        using Decimal3Detail::int128;
+        size_t count = 0;
+        uint64_t codes[BlockRows];
+        for (size_t b = 0; b < _blocks.size(); b++) {
+            const Decimal3Batch::detail::PackedBlock& block = _blocks[b];
+            size_t rows = block_rows(b);
+            // the bounds as codes, clamped to the codes the block can hold
+            int128 first = block.has_errors ? 1 : 0;
+            int128 last = static_cast<int128>(Decimal3Batch::detail::code_mask(block.width));
+            int128 from = static_cast<int128>(lo.value()) - block.base;
+            int128 to = static_cast<int128>(hi.value()) - block.base;
+            from = from > first ? from : first;
+            to = to < last ? to : last;
+            if (from > to)
+                continue;
+            if (from == first && to == last && !block.has_errors) {
+                count += rows;
+                continue;
+            }
+            unpack<false>(b, codes, rows);
+            uint64_t start = static_cast<uint64_t>(from);
+            uint64_t span = static_cast<uint64_t>(to - from);
+            for (size_t j = 0; j < rows; j++)
+                count += codes[j] - start <= span;
+        }
+        return count;
+    }
+
+    /// @brief exact sum of all rows; ErrorValue when a row is or the sum does not fit
+    Decimal3 sum() const {
+        using Decimal3Detail::int128;
+        int128 total = 0;
+        uint64_t codes[BlockRows];
+        for (size_t b = 0; b < _blocks.size(); b++) {
+            const Decimal3Batch::detail::PackedBlock& block = _blocks[b];
+            if (block.has_errors)
+                return Decimal3(Decimal3::ErrorValue);
+            size_t rows = block_rows(b);
+            total += static_cast<int128>(block.base) * static_cast<int64_t>(rows);
+            if (block.width == 0)
+                continue;
+            unpack<false>(b, codes, rows);
+            if (block.width <= 57) {
+                // BlockRows codes of 57 bits add up without overflow
+                uint64_t block_total = 0;
+                for (size_t j = 0; j < rows; j++)
+                    block_total += codes[j];
+                total += block_total;
+            }
+            else {
+                for (size_t j = 0; j < rows; j++)
+                    total += codes[j];
+            }
+        }
+        if (total > Decimal3::Params::LongMax || total < Decimal3::Params::LongMin)
+            return Decimal3(Decimal3::ErrorValue);
+        return Decimal3(static_cast<int64_t>(total));
+    }
+
+private:
+    std::vector<Decimal3Batch::detail::PackedBlock> _blocks;
+    std::vector<uint64_t> _words;
+    size_t _size = 0;
+
+    size_t block_rows(size_t b) const {
+        size_t rows = _size - b * BlockRows;
+        return rows < BlockRows ? rows : BlockRows;
+    }
+
+    template <bool Decode>
+    void unpack(size_t b, uint64_t* out, size_t rows) const {
+        const Decimal3Batch::detail::PackedBlock& block = _blocks[b];
+        if (rows == BlockRows || block.width == 0) {
+            Decimal3Batch::detail::unpack<Decode>(_words.data() + block.offset, block, out, rows);
+            return;
+        }
+        // the kernels write whole vectors
+        uint64_t tmp[BlockRows];
+        Decimal3Batch::detail::unpack<Decode>(_words.data() + block.offset, block, tmp, rows);
+        for (size_t j = 0; j < rows; j++)
+            out[j] = tmp[j];
+    }
+
+    void pack_block(const int64_t* v, size_t rows) {
+        bool has_errors = false;
+        bool any = false;
+        int64_t lo = 0, hi = 0;
+        for (size_t j = 0; j < rows; j++) {
+            if (v[j] == Decimal3::ErrorValue) {
+                has_errors = true;
+                continue;
+            }
+            lo = !any || v[j] < lo ? v[j] : lo;
+            hi = !any || v[j] > hi ? v[j] : hi;
+            any = true;
+        }
+        // valid values are within +-LongMax, so the range and the error code fit in 64 bits
+        uint64_t base = static_cast<uint64_t>(lo) - has_errors;
+        uint64_t range = static_cast<uint64_t>(hi) - base;
+        int width = range == 0 ? 0 : 64 - __builtin_clzll(range);
+
+        Decimal3Batch::detail::PackedBlock block = { static_cast<int64_t>(base), _words.size(), width, has_errors };
+        _blocks.push_back(block);
+        // full blocks of words, so every block starts on a word
+        _words.resize(_words.size() + BlockRows * static_cast<size_t>(width) / 64, 0);
+        uint64_t* words = _words.data() + block.offset;
+        for (size_t j = 0; j < rows && width > 0; j++) {
+            uint64_t code = v[j] == Decimal3::ErrorValue ? 0 : static_cast<uint64_t>(v[j]) - base;
+            size_t bit = j * static_cast<size_t>(width);
+            size_t shift = bit % 64;
+            words[bit / 64] |= code << shift;
+            if (shift != 0 && shift + static_cast<size_t>(width) > 64)
+                words[bit / 64 + 1] |= code >> (64 - shift);
+        }
+    }
+};
+
+#endif // DECIMAL3_PACKED_H
@@ -0,0 +1,162 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_PARALLEL_H
+#define DECIMAL3_PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Minimal fixed-size thread pool for the parallel Decimal3 algorithms.
+ *
+ * run() splits a job into numbered tasks which the workers and the calling
+ * thread pull from a shared counter, and returns once every task is done.
+ * One job runs at a time; concurrent run() calls are serialized. A task that
+ * calls run() on the pool running it, for example through a library function
+ * that defaults to shared(), gets its job run inline on its own thread.
+ */
+class Decimal3ThreadPool {
+public:
+    /// @brief threads includes the calling thread; 0 means hardware_concurrency().
+    explicit Decimal3ThreadPool(unsigned threads = 0) {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+        for (unsigned i = 1; i < threads; i++)
+            _workers.emplace_back([this] { worker(); });
+    }
+
+    ~Decimal3ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto& w : _workers)
+            w.join();
+    }
+
+    Decimal3ThreadPool(const Decimal3ThreadPool&) = delete;
+    Decimal3ThreadPool& operator=(const Decimal3ThreadPool&) = delete;
+
+    /// @brief number of threads working on a job, including the caller
+    unsigned size() const {
+        return static_cast<unsigned>(_workers.size()) + 1;
+    }
+
+    /// @brief calls task(i) for every i in [0, tasks) and waits for all of them.
+    void run(size_t tasks, const std::function<void(size_t)>& task) {
+        if (tasks == 0)
+            return;
+        // the pool is busy with the job that called us, so this one runs here
+        if (current() == this) {
+            for (size_t i = 0; i < tasks; i++)
+                task(i);
+            return;
+        }
+        std::lock_guard<std::mutex> serialize(_run_mutex);
+        Enter enter(this);
+        if (_workers.empty() || tasks == 1) {
+            for (size_t i = 0; i < tasks; i++)
+                task(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task = &task;
+            _tasks = tasks;
+            _next.store(0);
+            _done = 0;
+            _generation++;
+        }
+        _wake.notify_all();
+        size_t done = drain(task, tasks);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done += done;
+        // workers still in drain() would take indices from the next job
+        _finished.wait(lock, [this] { return _done == _tasks && _active == 0; });
+        _task = nullptr;
+    }
+
+    /// @brief pool shared by the library, sized to the hardware
+    static Decimal3ThreadPool& shared() {
+        static Decimal3ThreadPool pool;
+        return pool;
+    }
+
+private:
+    std::vector<std::thread> _workers;
+    std::mutex _run_mutex;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _finished;
+    const std::function<void(size_t)>* _task = nullptr;
+    size_t _tasks = 0;
+    size_t _done = 0;
+    std::atomic<size_t> _next { 0 };
+    /// workers in drain(), so run() does not return before they leave
+    unsigned _active = 0;
+    unsigned long long _generation = 0;
+    bool _stop = false;
+
+    /// pool whose job the calling thread is running
+    static const Decimal3ThreadPool*& current() {
+        static thread_local const Decimal3ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    struct Enter {
+        const Decimal3ThreadPool* previous;
+        explicit Enter(const Decimal3ThreadPool* pool) : previous(current()) { current() = pool; }
+        ~Enter() { current() = previous; }
+    };
+
+    size_t drain(const std::function<void(size_t)>& task, size_t tasks) {
+        size_t done = 0;
+        for (size_t i = _next.fetch_add(1); i < tasks; i = _next.fetch_add(1)) {
+            task(i);
+            done++;
+        }
+        return done;
+    }
+
+    void worker() {
+        current() = this;
+        unsigned long long seen = 0;
+        for (;;) {
+            const std::function<void(size_t)>* task = nullptr;
+            size_t tasks = 0;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [&] { return _stop || _generation != seen; });
+                if (_stop)
+                    return;
+                seen = _generation;
+                // a job that finished before this worker woke is gone
+                if (_task == nullptr)
+                    continue;
+                task = _task;
+                tasks = _tasks;
+                _active++;
+            }
+            size_t done = drain(*task, tasks);
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done += done;
+            _active--;
+            if (_done == _tasks && _active == 0)
+                _finished.notify_all();
+        }
+    }
+};
+
+#endif // DECIMAL3_PARALLEL_H
@@ -0,0 +1,517 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_REDUCE_H
+#define DECIMAL3_REDUCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "decimal3.h"
+#include "decimal3_batch.h"
+#include "decimal3_parallel.h"
+#include "decimal3_simd.h"
+
+/**
+ * Reductions over large arrays, split into fixed-size blocks that run on a
+ * Decimal3ThreadPool.
+ *
+ * Sums and dot products are accumulated exactly and range-checked once at the end,
+ * so a result is ErrorValue only when the final value does not fit; partial
+ * sums may exceed the range on the way. Any ErrorValue input makes the result
+ * ErrorValue. Since the arithmetic is exact, results do not depend on the
+ * number of threads.
+ */
+namespace Decimal3Batch {
+
+    namespace detail {
+
+        using Decimal3Detail::int128;
+        using Decimal3Detail::uint128;
+
+        /// Elements per task. Also bounds the per-lane sums of the SIMD kernels.
+        constexpr size_t ReduceBlock = size_t(1) << 16;
+
+        struct SumPartial {
+            int128 sum;
+            bool error;
+        };
+
+        struct RangePartial {
+            int64_t min;
+            int64_t max;
+            bool error;
+        };
+
+        /// Exact sum of 128-bit terms: acc wraps around and carry counts the wraps
+        struct WideSum {
+            int128 acc;
+            int64_t carry;
+
+            void add(int128 x) {
+                if (__builtin_add_overflow(acc, x, &acc))
+                    carry += x < 0 ? -1 : 1;
+            }
+        };
+
+        struct DotPartial {
+            WideSum sum;
+            bool error;
+        };
+
+        inline SumPartial sum_scalar(const int64_t* v, size_t n) {
+            int128 sum = 0;
+            bool error = false;
+            for (size_t i = 0; i < n; i++) {
+                sum += v[i];
+                error |= v[i] == Decimal3::ErrorValue;
+            }
+            return { sum, error };
+        }
+
+        inline void dot_add(DotPartial& p, int64_t a, int64_t b) {
+            p.sum.add(static_cast<int128>(a) * b);
+            p.error |= a == Decimal3::ErrorValue || b == Decimal3::ErrorValue;
+        }
+
+        inline DotPartial dot_scalar(const int64_t* a, const int64_t* b, size_t n) {
+            DotPartial p { { 0, 0 }, false };
+            for (size_t i = 0; i < n; i++)
+                dot_add(p, a[i], b[i]);
+            return p;
+        }
+
+        inline void fma_scalar(const int64_t* a, const int64_t* b, const int64_t* c, int64_t* out, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = Decimal3::safe_fma(a[i], b[i], c[i]);
+        }
+
+        inline RangePartial range_scalar(const int64_t* v, size_t n) {
+            RangePartial r { INT64_MAX, INT64_MIN, false };
+            for (size_t i = 0; i < n; i++) {
+                r.min = v[i] < r.min ? v[i] : r.min;
+                r.max = v[i] > r.max ? v[i] : r.max;
+                r.error |= v[i] == Decimal3::ErrorValue;
+            }
+            return r;
+        }
+
+#if DECIMAL3_X86_SIMD
+        // The SIMD sums flip the sign bit to make each value unsigned, then add
+        // its 32-bit halves in separate 64-bit lanes, which cannot overflow
+        // within a ReduceBlock. The bias of 2^63 per element is removed at the end.
+
+        inline int128 unbias(uint64_t hi, uint64_t lo, size_t count) {
+            uint128 total = (static_cast<uint128>(hi) << 32) + lo;
+            return static_cast<int128>(total - (static_cast<uint128>(count) << 63));
+        }
+
+        DECIMAL3_TARGET_AVX2
+        inline SumPartial sum_avx2(const int64_t* v, size_t n) {
+            const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+            const __m256i low = _mm256_set1_epi64x(0xFFFFFFFF);
+            const __m256i err = _mm256_set1_epi64x(Decimal3::ErrorValue);
+            __m256i lo = _mm256_setzero_si256();
+            __m256i hi = _mm256_setzero_si256();
+            __m256i bad = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+                bad = _mm256_or_si256(bad, _mm256_cmpeq_epi64(x, err));
+                __m256i u = _mm256_xor_si256(x, bias);
+                lo = _mm256_add_epi64(lo, _mm256_and_si256(u, low));
+                hi = _mm256_add_epi64(hi, _mm256_srli_epi64(u, 32));
+            }
+            alignas(32) uint64_t l[4], h[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(l), lo);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(h), hi);
+            SumPartial tail = sum_scalar(v + i, n - i);
+            tail.sum += unbias(h[0] + h[1] + h[2] + h[3], l[0] + l[1] + l[2] + l[3], i);
+            tail.error |= !_mm256_testz_si256(bad, bad);
+            return tail;
+        }
+
+        DECIMAL3_TARGET_AVX2
+        inline RangePartial range_avx2(const int64_t* v, size_t n) {
+            const __m256i err = _mm256_set1_epi64x(Decimal3::ErrorValue);
+            __m256i mn = _mm256_set1_epi64x(INT64_MAX);
+            __m256i mx = _mm256_set1_epi64x(INT64_MIN);
+            __m256i bad = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+                bad = _mm256_or_si256(bad, _mm256_cmpeq_epi64(x, err));
+                mn = _mm256_blendv_epi8(mn, x, _mm256_cmpgt_epi64(mn, x));
+                mx = _mm256_blendv_epi8(mx, x, _mm256_cmpgt_epi64(x, mx));
+            }
+            alignas(32) int64_t a[4], b[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(a), mn);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(b), mx);
+            RangePartial r = range_scalar(v + i, n - i);
+            for (int k = 0; k < 4; k++) {
+                r.min = a[k] < r.min ? a[k] : r.min;
+                r.max = b[k] > r.max ? b[k] : r.max;
+            }
+            r.error |= !_mm256_testz_si256(bad, bad);
+            return r;
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline SumPartial sum_avx512(const int64_t* v, size_t n) {
+            const __m512i bias = _mm512_set1_epi64(INT64_MIN);
+            const __m512i low = _mm512_set1_epi64(0xFFFFFFFF);
+            const __m512i err = _mm512_set1_epi64(Decimal3::ErrorValue);
+            __m512i lo = _mm512_setzero_si512();
+            __m512i hi = _mm512_setzero_si512();
+            __mmask8 bad = 0;
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m512i x = _mm512_loadu_si512(v + i);
+                bad |= _mm512_cmpeq_epi64_mask(x, err);
+                __m512i u = _mm512_xor_si512(x, bias);
+                lo = _mm512_add_epi64(lo, _mm512_and_si512(u, low));
+                hi = _mm512_add_epi64(hi, _mm512_srli_epi64(u, 32));
+            }
+            SumPartial tail = sum_scalar(v + i, n - i);
+            tail.sum += unbias(static_cast<uint64_t>(_mm512_reduce_add_epi64(hi)),
+                               static_cast<uint64_t>(_mm512_reduce_add_epi64(lo)), i);
+            tail.error |= bad != 0;
+            return tail;
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline RangePartial range_avx512(const int64_t* v, size_t n) {
+            const __m512i err = _mm512_set1_epi64(Decimal3::ErrorValue);
+            __m512i mn = _mm512_set1_epi64(INT64_MAX);
+            __m512i mx = _mm512_set1_epi64(INT64_MIN);
+            __mmask8 bad = 0;
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m512i x = _mm512_loadu_si512(v + i);
+                bad |= _mm512_cmpeq_epi64_mask(x, err);
+                mn = _mm512_min_epi64(mn, x);
+                mx = _mm512_max_epi64(mx, x);
+            }
+            RangePartial r = range_scalar(v + i, n - i);
+            int64_t a = _mm512_reduce_min_epi64(mn);
+            int64_t b = _mm512_reduce_max_epi64(mx);
+            r.min = a < r.min ? a : r.min;
+            r.max = b > r.max ? b : r.max;
+            r.error |= bad != 0;
+            return r;
+        }
+
+        // The dot kernels multiply lanes where both operands fit in int32, whose
+        // 64-bit products are summed like sum_avx2. Other lanes add 0 there and
+        // their exact product in scalar.
+
+        DECIMAL3_TARGET_AVX2
+        inline DotPartial dot_avx2(const int64_t* a, const int64_t* b, size_t n) {
+            const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+            const __m256i low = _mm256_set1_epi64x(0xFFFFFFFF);
+            const __m256i i32_lo = _mm256_set1_epi64x(static_cast<int64_t>(INT32_MIN) - 1);
+            const __m256i i32_hi = _mm256_set1_epi64x(static_cast<int64_t>(INT32_MAX) + 1);
+            __m256i lo = _mm256_setzero_si256();
+            __m256i hi = _mm256_setzero_si256();
+            DotPartial p { { 0, 0 }, false };
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+                __m256i fast = _mm256_and_si256(
+                    _mm256_and_si256(_mm256_cmpgt_epi64(x, i32_lo), _mm256_cmpgt_epi64(i32_hi, x)),
+                    _mm256_and_si256(_mm256_cmpgt_epi64(y, i32_lo), _mm256_cmpgt_epi64(i32_hi, y)));
+                __m256i u = _mm256_xor_si256(_mm256_and_si256(_mm256_mul_epi32(x, y), fast), bias);
+                lo = _mm256_add_epi64(lo, _mm256_and_si256(u, low));
+                hi = _mm256_add_epi64(hi, _mm256_srli_epi64(u, 32));
+                int fast_bits = _mm256_movemask_pd(_mm256_castsi256_pd(fast));
+                if (fast_bits != 0xF) {
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (!(fast_bits & (1 << lane)))
+                            dot_add(p, a[i + lane], b[i + lane]);
+                    }
+                }
+            }
+            alignas(32) uint64_t l[4], h[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(l), lo);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(h), hi);
+            p.sum.add(unbias(h[0] + h[1] + h[2] + h[3], l[0] + l[1] + l[2] + l[3], i));
+            for (; i < n; i++)
+                dot_add(p, a[i], b[i]);
+            return p;
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline DotPartial dot_avx512(const int64_t* a, const int64_t* b, size_t n) {
+            const __m512i bias = _mm512_set1_epi64(INT64_MIN);
+            const __m512i low = _mm512_set1_epi64(0xFFFFFFFF);
+            const __m512i i32_lo = _mm512_set1_epi64(INT32_MIN);
+            const __m512i i32_hi = _mm512_set1_epi64(INT32_MAX);
+            __m512i lo = _mm512_setzero_si512();
+            __m512i hi = _mm512_setzero_si512();
+            DotPartial p { { 0, 0 }, false };
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m512i x = _mm512_loadu_si512(a + i);
+                __m512i y = _mm512_loadu_si512(b + i);
+                __mmask8 fast = _mm512_cmpge_epi64_mask(x, i32_lo) & _mm512_cmple_epi64_mask(x, i32_hi)
+                              & _mm512_cmpge_epi64_mask(y, i32_lo) & _mm512_cmple_epi64_mask(y, i32_hi);
+                __m512i u = _mm512_xor_si512(_mm512_maskz_mov_epi64(fast, _mm512_mul_epi32(x, y)), bias);
+                lo = _mm512_add_epi64(lo, _mm512_and_si512(u, low));
+                hi = _mm512_add_epi64(hi, _mm512_srli_epi64(u, 32));
+                unsigned slow = static_cast<__mmask8>(~fast);
+                while (slow) {
+                    int lane = __builtin_ctz(slow);
+                    slow &= slow - 1;
+                    dot_add(p, a[i + lane], b[i + lane]);
+                }
+            }
+            p.sum.add(unbias(static_cast<uint64_t>(_mm512_reduce_add_epi64(hi)),
+                             static_cast<uint64_t>(_mm512_reduce_add_epi64(lo)), i));
+            for (; i < n; i++)
+                dot_add(p, a[i], b[i]);
+            return p;
+        }
+
+        // The fma kernels take the lanes of the multiply kernels whose addend
+        // has |c| < 2^40, so a * b + c * 1000 is exact in int64 and divided
+        // like a product. Other lanes are recomputed with Decimal3::safe_fma.
+        constexpr int64_t FastAddendLimit = 1LL << 40;
+
+        DECIMAL3_TARGET_AVX2
+        inline void fma_avx2(const int64_t* a, const int64_t* b, const int64_t* c, int64_t* out, size_t n) {
+            const __m256i i32_lo = _mm256_set1_epi64x(static_cast<int64_t>(INT32_MIN) - 1);
+            const __m256i i32_hi = _mm256_set1_epi64x(static_cast<int64_t>(INT32_MAX) + 1);
+            const __m256i c_lo = _mm256_set1_epi64x(-FastAddendLimit);
+            const __m256i c_hi = _mm256_set1_epi64x(FastAddendLimit);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+                __m256i z = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c + i));
+                __m256i fast = _mm256_and_si256(
+                    _mm256_and_si256(
+                        _mm256_and_si256(_mm256_cmpgt_epi64(x, i32_lo), _mm256_cmpgt_epi64(i32_hi, x)),
+                        _mm256_and_si256(_mm256_cmpgt_epi64(y, i32_lo), _mm256_cmpgt_epi64(i32_hi, y))),
+                    _mm256_and_si256(_mm256_cmpgt_epi64(z, c_lo), _mm256_cmpgt_epi64(c_hi, z)));
+                __m256i z1000 = _mm256_sub_epi64(_mm256_slli_epi64(z, 10),
+                                _mm256_add_epi64(_mm256_slli_epi64(z, 4), _mm256_slli_epi64(z, 3)));
+                __m256i q = divide_1000_avx2(_mm256_add_epi64(_mm256_mul_epi32(x, y), z1000), fast);
+
+                int fast_bits = _mm256_movemask_pd(_mm256_castsi256_pd(fast));
+                if (fast_bits != 0xF) {
+                    // patch slow lanes before the store, as out may alias an input
+                    alignas(32) int64_t tmp[4];
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(tmp), q);
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (!(fast_bits & (1 << lane)))
+                            tmp[lane] = Decimal3::safe_fma(a[i + lane], b[i + lane], c[i + lane]);
+                    }
+                    q = _mm256_load_si256(reinterpret_cast<const __m256i*>(tmp));
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), q);
+            }
+            fma_scalar(a + i, b + i, c + i, out + i, n - i);
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline void fma_avx512(const int64_t* a, const int64_t* b, const int64_t* c, int64_t* out, size_t n) {
+            const __m512i i32_lo = _mm512_set1_epi64(INT32_MIN);
+            const __m512i i32_hi = _mm512_set1_epi64(INT32_MAX);
+            const __m512i c_lo = _mm512_set1_epi64(-FastAddendLimit);
+            const __m512i c_hi = _mm512_set1_epi64(FastAddendLimit);
+            for (size_t i = 0; i < n; i += 8) {
+                __mmask8 m = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+                __m512i x = _mm512_maskz_loadu_epi64(m, a + i);
+                __m512i y = _mm512_maskz_loadu_epi64(m, b + i);
+                __m512i z = _mm512_maskz_loadu_epi64(m, c + i);
+                __mmask8 fast = _mm512_cmpge_epi64_mask(x, i32_lo) & _mm512_cmple_epi64_mask(x, i32_hi)
+                              & _mm512_cmpge_epi64_mask(y, i32_lo) & _mm512_cmple_epi64_mask(y, i32_hi)
+                              & _mm512_cmpgt_epi64_mask(z, c_lo) & _mm512_cmplt_epi64_mask(z, c_hi);
+                __m512i z1000 = _mm512_sub_epi64(_mm512_slli_epi64(z, 10),
+                                _mm512_add_epi64(_mm512_slli_epi64(z, 4), _mm512_slli_epi64(z, 3)));
+                __m512i q = divide_1000_avx512(_mm512_add_epi64(_mm512_mul_epi32(x, y), z1000), fast);
+
+                unsigned slow = m & ~fast;
+                if (slow) {
+                    // patch slow lanes before the store, as out may alias an input
+                    alignas(64) int64_t tmp[8];
+                    _mm512_store_si512(tmp, q);
+                    while (slow) {
+                        int lane = __builtin_ctz(slow);
+                        slow &= slow - 1;
+                        tmp[lane] = Decimal3::safe_fma(a[i + lane], b[i + lane], c[i + lane]);
+                    }
+                    q = _mm512_load_si512(tmp);
+                }
+                _mm512_mask_storeu_epi64(out + i, m, q);
+            }
+        }
+#endif
+
+        inline SumPartial (*sum_kernel())(const int64_t*, size_t) {
+            switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+            case Decimal3Simd::Isa::Avx512: return sum_avx512;
+            case Decimal3Simd::Isa::Avx2:   return sum_avx2;
+#endif
+            default: return sum_scalar;
+            }
+        }
+
+        inline RangePartial (*range_kernel())(const int64_t*, size_t) {
+            switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+            case Decimal3Simd::Isa::Avx512: return range_avx512;
+            case Decimal3Simd::Isa::Avx2:   return range_avx2;
+#endif
+            default: return range_scalar;
+            }
+        }
+
+        inline DotPartial (*dot_kernel())(const int64_t*, const int64_t*, size_t) {
+            switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+            case Decimal3Simd::Isa::Avx512: return dot_avx512;
+            case Decimal3Simd::Isa::Avx2:   return dot_avx2;
+#endif
+            default: return dot_scalar;
+            }
+        }
+
+        /// runs kernel over each ReduceBlock of v and returns the partials in block order
+        template <class Partial>
+        inline std::vector<Partial> reduce_blocks(const int64_t* v, size_t n, Decimal3ThreadPool& pool,
+                                                  Partial (*kernel)(const int64_t*, size_t)) {
+            size_t blocks = (n + ReduceBlock - 1) / ReduceBlock;
+            std::vector<Partial> partials(blocks);
+            pool.run(blocks, [&](size_t b) {
+                size_t begin = b * ReduceBlock;
+                size_t len = n - begin < ReduceBlock ? n - begin : ReduceBlock;
+                partials[b] = kernel(v + begin, len);
+            });
+            return partials;
+        }
+
+        inline SumPartial total(const int64_t* v, size_t n, Decimal3ThreadPool& pool) {
+            SumPartial t { 0, false };
+            for (const SumPartial& p : reduce_blocks(v, n, pool, sum_kernel())) {
+                t.sum += p.sum;
+                t.error |= p.error;
+            }
+            return t;
+        }
+
+        inline RangePartial range(const int64_t* v, size_t n, Decimal3ThreadPool& pool) {
+            RangePartial r { INT64_MAX, INT64_MIN, false };
+            for (const RangePartial& p : reduce_blocks(v, n, pool, range_kernel())) {
+                r.min = p.min < r.min ? p.min : r.min;
+                r.max = p.max > r.max ? p.max : r.max;
+                r.error |= p.error;
+            }
+            return r;
+        }
+    }
+
+    /// @brief sum of n values; 0 when n is 0.
+    inline int64_t sum(const int64_t* values, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        detail::SumPartial t = detail::total(values, n, pool);
+        if (t.error || t.sum > Decimal3::Params::LongMax || t.sum < Decimal3::Params::LongMin)
+            return Decimal3::ErrorValue;
+        return static_cast<int64_t>(t.sum);
+    }
+
+    /// @brief smallest of n values; ErrorValue when n is 0.
+    inline int64_t min(const int64_t* values, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        detail::RangePartial r = detail::range(values, n, pool);
+        return r.error || n == 0 ? Decimal3::ErrorValue : r.min;
+    }
+
+    /// @brief largest of n values; ErrorValue when n is 0.
+    inline int64_t max(const int64_t* values, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        detail::RangePartial r = detail::range(values, n, pool);
+        return r.error || n == 0 ? Decimal3::ErrorValue : r.max;
+    }
+
+    /// @brief arithmetic mean, rounded like Decimal3's division; ErrorValue when n is 0.
+    inline int64_t mean(const int64_t* values, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        detail::SumPartial t = detail::total(values, n, pool);
+        if (t.error || n == 0)
+            return Decimal3::ErrorValue;
+        using detail::uint128;
+        bool negative = t.sum < 0;
+        uint128 m = negative ? 0 - static_cast<uint128>(t.sum) : static_cast<uint128>(t.sum);
+        uint128 q = Decimal3Detail::round_divide<Decimal3::rounding_type>(m, static_cast<uint128>(n), negative);
+        return negative ? -static_cast<int64_t>(q) : static_cast<int64_t>(q);
+    }
+
+    /// @brief sum of a[i] * b[i], with exact products and sums rounded once at the end
+    /// like Decimal3::safe_multiply. ErrorValue when any term is an error or the result does not fit.
+    inline int64_t dot(const int64_t* a, const int64_t* b, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        using detail::uint128;
+        auto kernel = detail::dot_kernel();
+        size_t blocks = (n + detail::ReduceBlock - 1) / detail::ReduceBlock;
+        std::vector<detail::DotPartial> partials(blocks);
+        pool.run(blocks, [&](size_t k) {
+            size_t begin = k * detail::ReduceBlock;
+            size_t len = n - begin < detail::ReduceBlock ? n - begin : detail::ReduceBlock;
+            partials[k] = kernel(a + begin, b + begin, len);
+        });
+        detail::WideSum total { 0, 0 };
+        bool error = false;
+        for (const auto& p : partials) {
+            total.add(p.sum.acc);
+            total.carry += p.sum.carry;
+            error |= p.error;
+        }
+        // any wrap left means |total| >= 2^127, far out of range
+        if (error || total.carry != 0)
+            return Decimal3::ErrorValue;
+        bool negative = total.acc < 0;
+        uint128 m = negative ? 0 - static_cast<uint128>(total.acc) : static_cast<uint128>(total.acc);
+        uint128 q = Decimal3Detail::round_divide<Decimal3::rounding_type>(m, static_cast<uint128>(Decimal3::Params::Factor), negative);
+        if (q > static_cast<uint128>(Decimal3::Params::LongMax))
+            return Decimal3::ErrorValue;
+        return negative ? -static_cast<int64_t>(q) : static_cast<int64_t>(q);
+    }
+
+    /// @brief out[i] = a[i] * b[i] + c[i] with a single rounding, see Decimal3::safe_fma
+    inline void fma(const int64_t* a, const int64_t* b, const int64_t* c, int64_t* out, size_t n) {
+        switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+        case Decimal3Simd::Isa::Avx512: return detail::fma_avx512(a, b, c, out, n);
+        case Decimal3Simd::Isa::Avx2:   return detail::fma_avx2(a, b, c, out, n);
+#endif
+        default: return detail::fma_scalar(a, b, c, out, n);
+        }
+    }
+
+    inline Decimal3 sum(const Decimal3* values, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        return Decimal3(sum(detail::raw(values), n, pool));
+    }
+
+    inline Decimal3 min(const Decimal3* values, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        return Decimal3(min(detail::raw(values), n, pool));
+    }
+
+    inline Decimal3 max(const Decimal3* values, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        return Decimal3(max(detail::raw(values), n, pool));
+    }
+
+    inline Decimal3 mean(const Decimal3* values, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        return Decimal3(mean(detail::raw(values), n, pool));
+    }
+
+    inline Decimal3 dot(const Decimal3* a, const Decimal3* b, size_t n, Decimal3ThreadPool& pool = Decimal3ThreadPool::shared()) {
+        return Decimal3(dot(detail::raw(a), detail::raw(b), n, pool));
+    }
+
+    inline void fma(const Decimal3* a, const Decimal3* b, const Decimal3* c, Decimal3* out, size_t n) {
+        fma(detail::raw(a), detail::raw(b), detail::raw(c), detail::raw(out), n);
+    }
+}
+
+#endif // DECIMAL3_REDUCE_H
@@ -0,0 +1,133 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_RESCALE_H
+#define DECIMAL3_RESCALE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "decimal3.h"
+#include "decimal3_batch.h"
+#include "decimal3_divisor.h"
+#include "decimal3_simd.h"
+
+/**
+ * Conversion of integers with a fixed number of implied decimals, as sent by
+ * venues and feeds, to and from Decimal3 without going through double.
+ *
+ * Adding digits multiplies by a power of ten and fails with ErrorValue past
+ * LongMax. Dropping digits divides by one through Decimal3Divisor and rounds
+ * like Decimal3::from_scaled(). The minimum of int64_t, which is ErrorValue,
+ * converts to ErrorValue either way.
+ */
+namespace Decimal3Batch {
+
+    namespace detail {
+
+        inline void scale_up_scalar(const int64_t* in, int shift, int64_t* out, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = Decimal3Detail::rescale<Decimal3::rounding_type>(in[i], shift, Decimal3::Params::LongMax);
+        }
+
+#if DECIMAL3_X86_SIMD
+        // The scale up kernels check |x| <= LongMax / 10^shift and take the low
+        // 64 bits of x * 10^shift from three 32 x 32 bit products, which is the
+        // whole product for every lane that passes the check.
+
+        DECIMAL3_TARGET_AVX2
+        inline void scale_up_avx2(const int64_t* in, int shift, int64_t* out, size_t n) {
+            const uint64_t p = Decimal3Detail::Pow10[shift];
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i err = _mm256_set1_epi64x(Decimal3::ErrorValue);
+            const __m256i minus_one = _mm256_set1_epi64x(-1);
+            const __m256i limit = _mm256_set1_epi64x(static_cast<int64_t>(Decimal3::Params::LongMax / p) + 1);
+            const __m256i p_lo = _mm256_set1_epi64x(static_cast<int64_t>(p & 0xFFFFFFFF));
+            const __m256i p_hi = _mm256_set1_epi64x(static_cast<int64_t>(p >> 32));
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                __m256i m = _mm256_blendv_epi8(x, _mm256_sub_epi64(zero, x), _mm256_cmpgt_epi64(zero, x));
+                // ErrorValue stays negative and fails the limit
+                __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi64(limit, m), _mm256_cmpgt_epi64(m, minus_one));
+                __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), p_lo), _mm256_mul_epu32(x, p_hi));
+                __m256i v = _mm256_add_epi64(_mm256_mul_epu32(x, p_lo), _mm256_slli_epi64(cross, 32));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_blendv_epi8(err, v, ok));
+            }
+            scale_up_scalar(in + i, shift, out + i, n - i);
+        }
+
+        DECIMAL3_TARGET_AVX512
+        inline void scale_up_avx512(const int64_t* in, int shift, int64_t* out, size_t n) {
+            const uint64_t p = Decimal3Detail::Pow10[shift];
+            const __m512i zero = _mm512_setzero_si512();
+            const __m512i err = _mm512_set1_epi64(Decimal3::ErrorValue);
+            const __m512i limit = _mm512_set1_epi64(static_cast<int64_t>(Decimal3::Params::LongMax / p));
+            const __m512i p_lo = _mm512_set1_epi64(static_cast<int64_t>(p & 0xFFFFFFFF));
+            const __m512i p_hi = _mm512_set1_epi64(static_cast<int64_t>(p >> 32));
+            for (size_t i = 0; i < n; i += 8) {
+                __mmask8 k = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+                __m512i x = _mm512_maskz_loadu_epi64(k, in + i);
+                __m512i m = _mm512_abs_epi64(x);
+                // ErrorValue stays negative and fails the limit
+                __mmask8 ok = _mm512_cmple_epi64_mask(m, limit) & _mm512_cmpge_epi64_mask(m, zero);
+                __m512i cross = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(x, 32), p_lo), _mm512_mul_epu32(x, p_hi));
+                __m512i v = _mm512_add_epi64(_mm512_mul_epu32(x, p_lo), _mm512_slli_epi64(cross, 32));
+                _mm512_mask_storeu_epi64(out + i, k, _mm512_mask_blend_epi64(ok, err, v));
+            }
+        }
+#endif
+
+        /// out[i] = in[i] * 10^shift for |shift| <= 18, rounded when shift < 0
+        inline void rescale(const int64_t* in, int shift, int64_t* out, size_t n) {
+            if (shift < 0) {
+                Decimal3Divisor::from_integer(static_cast<int64_t>(Decimal3Detail::Pow10[-shift])).divide(in, out, n);
+                return;
+            }
+            if (shift == 0) {
+                if (out != in)
+                    std::memmove(out, in, n * sizeof(int64_t));
+                return;
+            }
+            switch (Decimal3Simd::active_isa()) {
+#if DECIMAL3_X86_SIMD
+            case Decimal3Simd::Isa::Avx512: return scale_up_avx512(in, shift, out, n);
+            case Decimal3Simd::Isa::Avx2:   return scale_up_avx2(in, shift, out, n);
+#endif
+            default: return scale_up_scalar(in, shift, out, n);
+            }
+        }
+
+        inline void fill_error(int64_t* out, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = Decimal3::ErrorValue;
+        }
+    }
+
+    /// @brief out[i] = Decimal3::from_scaled(in[i], digits).value(). out may alias in.
+    inline void from_scaled(const int64_t* in, int digits, int64_t* out, size_t n) {
+        if (digits < 0 || digits > 18)
+            return detail::fill_error(out, n);
+        detail::rescale(in, Decimal3::scale - digits, out, n);
+    }
+
+    /// @brief out[i] = Decimal3(in[i]).to_scaled(digits). out may alias in.
+    inline void to_scaled(const int64_t* in, int digits, int64_t* out, size_t n) {
+        if (digits < 0 || digits > 18)
+            return detail::fill_error(out, n);
+        detail::rescale(in, digits - Decimal3::scale, out, n);
+    }
+
+    inline void from_scaled(const int64_t* in, int digits, Decimal3* out, size_t n) {
+        from_scaled(in, digits, detail::raw(out), n);
+    }
+
+    inline void to_scaled(const Decimal3* in, int digits, int64_t* out, size_t n) {
+        to_scaled(detail::raw(in), digits, out, n);
+    }
+}
+
+#endif // DECIMAL3_RESCALE_H
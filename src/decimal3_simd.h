@@ -0,0 +1,68 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_SIMD_H
+#define DECIMAL3_SIMD_H
+
+#include <atomic>
+
+// SIMD kernels are compiled with per-function target attributes and picked
+// at runtime, so the library itself does not need -mavx2 / -mavx512f.
+// Define DECIMAL3_NO_SIMD to build the scalar kernels only.
+#if !defined(DECIMAL3_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DECIMAL3_X86_SIMD 1
+#include <immintrin.h>
+#define DECIMAL3_TARGET_AVX2   __attribute__((target("avx2")))
+#define DECIMAL3_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define DECIMAL3_X86_SIMD 0
+#endif
+
+namespace Decimal3Simd {
+
+    /// Instruction sets a batch kernel can be dispatched to, in ascending order.
+    enum class Isa : int {
+        Scalar = 0,
+        Avx2   = 1,
+        Avx512 = 2,
+    };
+
+    /// @brief returns the best instruction set supported by the running cpu.
+    inline Isa detect_isa() {
+#if DECIMAL3_X86_SIMD
+        static const Isa detected = [] {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f"))
+                return Isa::Avx512;
+            if (__builtin_cpu_supports("avx2"))
+                return Isa::Avx2;
+            return Isa::Scalar;
+        }();
+        return detected;
+#else
+        return Isa::Scalar;
+#endif
+    }
+
+    inline std::atomic<int>& isa_limit_storage() {
+        static std::atomic<int> limit { static_cast<int>(Isa::Avx512) };
+        return limit;
+    }
+
+    /// @brief caps the instruction set used by batch kernels. Useful for testing and benchmarking.
+    inline void limit_isa(Isa isa) {
+        isa_limit_storage().store(static_cast<int>(isa), std::memory_order_relaxed);
+    }
+
+    /// @brief returns the instruction set batch kernels dispatch to.
+    inline Isa active_isa() {
+        int detected = static_cast<int>(detect_isa());
+        int limit = isa_limit_storage().load(std::memory_order_relaxed);
+        return static_cast<Isa>(detected < limit ? detected : limit);
+    }
+}
+
+#endif // DECIMAL3_SIMD_H
@@ -0,0 +1,138 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_SORT_H
+#define DECIMAL3_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "decimal3.h"
+#include "decimal3_batch.h"
+
+/**
+ * Sorting of Decimal3 arrays by LSD radix sort on the internal value.
+ *
+ * The order is the one of Decimal3::operator<, so ErrorValue sorts first.
+ * Keys are offset by the smallest one, which makes them unsigned without
+ * changing their order, and read 11 bits at a time. Only the digits covering
+ * the range of the keys are sorted, and passes whose digit is the same in
+ * every key are skipped, so prices or P&L in a narrow band take 2 to 3 passes.
+ */
+namespace Decimal3Batch {
+
+    namespace detail {
+
+        /// Below this size the sorts fall back to comparison sorting
+        constexpr size_t RadixSortThreshold = 128;
+
+        constexpr int RadixBits = 11;
+        constexpr size_t RadixSize = size_t(1) << RadixBits;
+
+        /// sorts keys[0, n) stably, permuting index alongside when it is not null.
+        /// key_tmp and index_tmp are scratch buffers of n elements.
+        inline void radix_sort(int64_t* keys, int64_t* key_tmp, size_t* index, size_t* index_tmp, size_t n) {
+            // keys are sorted as key - min, which keeps their order and
+            // leaves only as many digits as the range of the keys needs
+            int64_t lo = keys[0], hi = keys[0];
+            for (size_t i = 1; i < n; i++) {
+                lo = keys[i] < lo ? keys[i] : lo;
+                hi = keys[i] > hi ? keys[i] : hi;
+            }
+            const uint64_t base = static_cast<uint64_t>(lo);
+            const uint64_t range = static_cast<uint64_t>(hi) - base;
+            int passes = 0;
+            while (passes * RadixBits < 64 && (range >> (passes * RadixBits)) != 0)
+                passes++;
+            auto digit = [base](int64_t x, int pass) {
+                return static_cast<size_t>(((static_cast<uint64_t>(x) - base) >> (pass * RadixBits)) & (RadixSize - 1));
+            };
+
+            // histograms of all passes in one read
+            std::vector<size_t> counts(passes * RadixSize, 0);
+            for (size_t i = 0; i < n; i++) {
+                for (int pass = 0; pass < passes; pass++)
+                    counts[pass * RadixSize + digit(keys[i], pass)]++;
+            }
+
+            int64_t* src = keys;
+            int64_t* dst = key_tmp;
+            size_t* isrc = index;
+            size_t* idst = index_tmp;
+            for (int pass = 0; pass < passes; pass++) {
+                size_t* count = counts.data() + pass * RadixSize;
+                if (count[digit(src[0], pass)] == n)
+                    continue;
+                size_t offset = 0;
+                for (size_t d = 0; d < RadixSize; d++) {
+                    size_t c = count[d];
+                    count[d] = offset;
+                    offset += c;
+                }
+                if (index) {
+                    for (size_t i = 0; i < n; i++) {
+                        size_t at = count[digit(src[i], pass)]++;
+                        dst[at] = src[i];
+                        idst[at] = isrc[i];
+                    }
+                    std::swap(isrc, idst);
+                }
+                else {
+                    for (size_t i = 0; i < n; i++)
+                        dst[count[digit(src[i], pass)]++] = src[i];
+                }
+                std::swap(src, dst);
+            }
+            if (src != keys) {
+                std::copy(src, src + n, keys);
+                if (index)
+                    std::copy(isrc, isrc + n, index);
+            }
+        }
+    }
+
+    /// @brief sorts n internal values in ascending order
+    inline void sort(int64_t* values, size_t n) {
+        if (n < detail::RadixSortThreshold) {
+            std::sort(values, values + n);
+            return;
+        }
+        std::vector<int64_t> tmp(n);
+        detail::radix_sort(values, tmp.data(), nullptr, nullptr, n);
+    }
+
+    /// @brief writes to index the positions of values in ascending order.
+    /// Equal values keep their original order.
+    inline void argsort(const int64_t* values, size_t n, size_t* index) {
+        for (size_t i = 0; i < n; i++)
+            index[i] = i;
+        if (n < detail::RadixSortThreshold) {
+            std::stable_sort(index, index + n, [values](size_t a, size_t b) { return values[a] < values[b]; });
+            return;
+        }
+        std::vector<int64_t> keys(values, values + n);
+        std::vector<int64_t> key_tmp(n);
+        std::vector<size_t> index_tmp(n);
+        detail::radix_sort(keys.data(), key_tmp.data(), index, index_tmp.data(), n);
+    }
+
+    inline void sort(Decimal3* values, size_t n) {
+        sort(detail::raw(values), n);
+    }
+
+    inline void argsort(const Decimal3* values, size_t n, size_t* index) {
+        argsort(detail::raw(values), n, index);
+    }
+
+    inline std::vector<size_t> argsort(const Decimal3* values, size_t n) {
+        std::vector<size_t> index(n);
+        argsort(values, n, index.data());
+        return index;
+    }
+}
+
+#endif // DECIMAL3_SORT_H
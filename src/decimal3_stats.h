@@ -0,0 +1,177 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_STATS_H
+#define DECIMAL3_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Counters of the slow and error paths of Decimal, one set per thread.
+ *
+ * Counting is compiled in only when DECIMAL3_STATS is defined to 1 before
+ * decimal3.h is included; define it the same way in every translation unit,
+ * best as a compile definition. Otherwise the hooks expand to nothing and all
+ * counts stay zero. Only the operation that produces an error is counted, not
+ * the ones that pass an ErrorValue operand along. Constant evaluation is not
+ * counted, and the batch kernels count only the lanes they hand to the scalar
+ * functions.
+ *
+ * Each thread increments its own counters without locking. snapshot() adds up
+ * the counters of every thread, including threads that have exited.
+ */
+namespace Decimal3Stats {
+
+    enum class Counter : unsigned {
+        /// NaN or infinity given to from(double), or to multiply / divide by double
+        DoubleNonFinite,
+        /// double past MaxValueD
+        DoubleOutOfRange,
+        /// double past MaxRoundableAccurateNumD, rounded after scaling, so the
+        /// last digit may be off
+        DoubleRounded,
+        /// double past MaxAccurateNumD, fraction digits dropped
+        DoublePrecisionLoss,
+        /// add or subtract past LongMax / LongMin
+        AddOverflow,
+        /// multiply or fma past LongMax, or a product by double past MaxSafeNumD
+        MultiplyOverflow,
+        /// divide past LongMax, or a quotient by double past MaxAccurateNumD
+        DivideOverflow,
+        /// division by zero
+        DivideByZero,
+        /// text without digits
+        ParseInvalid,
+        /// text past MaxValue
+        ParseOverflow,
+        Count,
+    };
+
+    constexpr size_t CounterCount = static_cast<size_t>(Counter::Count);
+
+    constexpr const char* name(Counter counter) {
+        constexpr const char* names[CounterCount] = {
+            "double_non_finite", "double_out_of_range", "double_rounded", "double_precision_loss",
+            "add_overflow", "multiply_overflow", "divide_overflow", "divide_by_zero",
+            "parse_invalid", "parse_overflow",
+        };
+        return counter < Counter::Count ? names[static_cast<size_t>(counter)] : "";
+    }
+
+    /// Counts at one point in time
+    struct Snapshot {
+        uint64_t counts[CounterCount] = {};
+
+        uint64_t operator[](Counter counter) const {
+            return counts[static_cast<size_t>(counter)];
+        }
+
+        /// @brief sum of all counters
+        uint64_t total() const {
+            uint64_t sum = 0;
+            for (uint64_t c : counts)
+                sum += c;
+            return sum;
+        }
+
+        Snapshot& operator+=(const Snapshot& other) {
+            for (size_t i = 0; i < CounterCount; i++)
+                counts[i] += other.counts[i];
+            return *this;
+        }
+
+        /// @brief counts since an earlier snapshot
+        Snapshot operator-(const Snapshot& earlier) const {
+            Snapshot delta;
+            for (size_t i = 0; i < CounterCount; i++)
+                delta.counts[i] = counts[i] - earlier.counts[i];
+            return delta;
+        }
+    };
+
+    namespace detail {
+
+        struct ThreadCounters;
+
+        struct Registry {
+            std::mutex mutex;
+            std::vector<const ThreadCounters*> live;
+            /// counts of threads that have exited
+            Snapshot retired;
+        };
+
+        inline Registry& registry() {
+            static Registry r;
+            return r;
+        }
+
+        struct ThreadCounters {
+            std::atomic<uint64_t> counts[CounterCount] = {};
+
+            ThreadCounters() {
+                // the registry is constructed first, so it outlives every thread's counters
+                Registry& r = registry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                r.live.push_back(this);
+            }
+
+            ~ThreadCounters() {
+                Registry& r = registry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                r.retired += read();
+                for (size_t i = 0; i < r.live.size(); i++) {
+                    if (r.live[i] == this) {
+                        r.live[i] = r.live.back();
+                        r.live.pop_back();
+                        break;
+                    }
+                }
+            }
+
+            ThreadCounters(const ThreadCounters&) = delete;
+            ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+            Snapshot read() const {
+                Snapshot s;
+                for (size_t i = 0; i < CounterCount; i++)
+                    s.counts[i] = counts[i].load(std::memory_order_relaxed);
+                return s;
+            }
+        };
+
+        inline ThreadCounters& local() {
+            static thread_local ThreadCounters counters;
+            return counters;
+        }
+
+        inline void increment(Counter counter) {
+            // only this thread writes, a plain add is enough and needs no lock prefix
+            std::atomic<uint64_t>& c = local().counts[static_cast<size_t>(counter)];
+            c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief counts of the calling thread
+    inline Snapshot thread_snapshot() {
+        return detail::local().read();
+    }
+
+    /// @brief counts of all threads, live and exited
+    inline Snapshot snapshot() {
+        detail::Registry& r = detail::registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        Snapshot s = r.retired;
+        for (const detail::ThreadCounters* counters : r.live)
+            s += counters->read();
+        return s;
+    }
+}
+
+#endif // DECIMAL3_STATS_H
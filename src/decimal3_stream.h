@@ -0,0 +1,289 @@
+
+//          Copyright Yamavol 2022 - 2022.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef DECIMAL3_STREAM_H
+#define DECIMAL3_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include "decimal3.h"
+
+/**
+ * Parsing of Decimal3 values from text that arrives in chunks.
+ *
+ * Values are tokens separated by whitespace or a separator character, ','
+ * by default; runs of them count as one. Each token reads like
+ * Decimal3::from(const char*) reads it on its own, with the same rounding:
+ * text after the number is ignored, a token without digits is 0 and one out
+ * of range is ErrorValue.
+ *
+ * A token split between two chunks is carried over in the parser's state,
+ * so chunks are fed as they are read, without copying them together. Tokens
+ * that lie within a chunk take the parser of Decimal3 directly.
+ */
+namespace Decimal3Stream {
+
+    /// Result of Parser::feed() into an array
+    struct FeedResult {
+        /// first byte not consumed
+        const char* ptr;
+        /// values written
+        size_t count;
+    };
+
+    class Parser {
+    public:
+        explicit Parser(char separator = ',') : _separator(separator) {}
+
+        /// @brief parses [first, last), calling emit(Decimal3) for every value completed
+        template <class F>
+        void feed(const char* first, const char* last, F&& emit) {
+            run(first, last, [&emit](Decimal3 value) {
+                emit(value);
+                return true;
+            });
+        }
+
+        /// @brief parses [first, last) until n values have been written to out.
+        /// Pass the rest from ptr again when count is n.
+        FeedResult feed(const char* first, const char* last, Decimal3* out, size_t n) {
+            if (n == 0)
+                return { first, 0 };
+            size_t count = 0;
+            const char* p = run(first, last, [out, n, &count](Decimal3 value) {
+                out[count++] = value;
+                return count < n;
+            });
+            return { p, count };
+        }
+
+        /// @brief ends the stream, emitting the value cut off by its end if there is one
+        template <class F>
+        void finish(F&& emit) {
+            if (pending())
+                emit(take());
+        }
+
+        /// @brief ends the stream. Returns false when no value was cut off by its end.
+        bool finish(Decimal3& value) {
+            if (!pending())
+                return false;
+            value = take();
+            return true;
+        }
+
+        /// @brief true when a token has started but not ended
+        bool pending() const { return _state != State::Idle; }
+
+        /// @brief starts a new stream
+        void reset() { *this = Parser(_separator); }
+
+    private:
+        enum class State : uint8_t {
+            /// between tokens
+            Idle,
+            /// token started, nothing read yet
+            Start,
+            /// after a leading '+'
+            Plus,
+            /// after the sign
+            Sign,
+            Integer,
+            /// after '.'
+            Fraction,
+            /// number ended, the rest of the token is ignored
+            Done,
+        };
+
+        using Params = Decimal3::Params;
+        /// fraction digits kept for rounding, like the parser of Decimal3
+        static constexpr int Keep = Decimal3::scale + 1;
+
+        bool is_delimiter(char c) const {
+            return c == ' ' || (c >= '\t' && c <= '\r') || c == _separator;
+        }
+
+        template <class F>
+        const char* run(const char* p, const char* last, F&& emit) {
+            while (p != last) {
+                char c = *p;
+                if (_state == State::Idle) {
+                    if (is_delimiter(c)) {
+                        p++;
+                        continue;
+                    }
+                    // With three bytes left a number without digits stays one,
+                    // so only a valid number reaching last may still grow.
+                    if ((Decimal3Detail::is_digit(c) || c == '-' || c == '.') && last - p > 2) {
+                        int64_t value = 0;
+                        auto r = Decimal3::parse_chars_to_internal_long(p, last, value);
+                        if (r.ec == std::errc::invalid_argument) {
+                            // ptr is first, skip the token from its next byte
+                            end_number(0);
+                            p++;
+                            continue;
+                        }
+                        if (r.ec == std::errc() && r.ptr == last) {
+                            begin_token();
+                        }
+                        else {
+                            if (r.ec != std::errc())
+                                value = Decimal3::ErrorValue;
+                            p = r.ptr;
+                            if (p != last && is_delimiter(*p)) {
+                                p++;
+                                if (!emit(Decimal3(value)))
+                                    return p;
+                            }
+                            else {
+                                end_number(value);
+                            }
+                            continue;
+                        }
+                    }
+                    else {
+                        begin_token();
+                    }
+                }
+                if (is_delimiter(c)) {
+                    p++;
+                    if (!emit(take()))
+                        return p;
+                    continue;
+                }
+                step(c);
+                p++;
+            }
+            return p;
+        }
+
+        void begin_token() {
+            _state = State::Start;
+            _negative = false;
+            _has_integer = false;
+            _has_fraction = false;
+            _sticky = false;
+            _fraction_digits = 0;
+            _integer = 0;
+            _fraction = 0;
+        }
+
+        void end_number(int64_t value) {
+            _state = State::Done;
+            _value = value;
+        }
+
+        /// reads one byte of a token
+        void step(char c) {
+            using Decimal3Detail::is_digit;
+            switch (_state) {
+            case State::Start:
+                if (c == '+') {
+                    _state = State::Plus;
+                    return;
+                }
+                if (c == '-') {
+                    _negative = true;
+                    _state = State::Sign;
+                    return;
+                }
+                return sign(c);
+            case State::Plus:
+                // "+-" is not skipped by Decimal3::from(), and reads as no digits
+                if (c == '-')
+                    return end_number(value());
+                return sign(c);
+            case State::Sign:
+                return sign(c);
+            case State::Integer:
+                if (is_digit(c)) {
+                    // past MaxValue the integer stops growing, it is an error either way
+                    if (_integer <= static_cast<uint64_t>(Params::MaxValue))
+                        _integer = _integer * 10 + static_cast<uint64_t>(c - '0');
+                    return;
+                }
+                if (c == '.') {
+                    _state = State::Fraction;
+                    return;
+                }
+                return end_number(value());
+            case State::Fraction:
+                if (is_digit(c)) {
+                    _has_fraction = true;
+                    if (_fraction_digits < Keep) {
+                        _fraction = _fraction * 10 + static_cast<uint64_t>(c - '0');
+                        _fraction_digits++;
+                    }
+                    else {
+                        _sticky |= c != '0';
+                    }
+                    return;
+                }
+                return end_number(value());
+            default:
+                return;
+            }
+        }
+
+        /// reads the first byte after the sign
+        void sign(char c) {
+            if (Decimal3Detail::is_digit(c)) {
+                _has_integer = true;
+                _integer = static_cast<uint64_t>(c - '0');
+                _state = State::Integer;
+            }
+            else if (c == '.') {
+                _state = State::Fraction;
+            }
+            else {
+                end_number(value());
+            }
+        }
+
+        /// value of the number read so far, as parse_chars_to_internal_long() gives it
+        int64_t value() const {
+            using Decimal3Detail::Pow10;
+            if (!_has_integer && !_has_fraction) {
+                DECIMAL3_COUNT(ParseInvalid);
+                return 0;
+            }
+            if (_integer > static_cast<uint64_t>(Params::MaxValue)) {
+                DECIMAL3_COUNT(ParseOverflow);
+                return Decimal3::ErrorValue;
+            }
+            uint64_t digits = _fraction * Pow10[Keep - _fraction_digits];
+            uint64_t magnitude = _integer * Params::Factor + digits / 10;
+            magnitude += Decimal3::rounding_type::round_up(magnitude, digits % 10 * 2 + _sticky, uint64_t(20), _negative);
+            if (magnitude > static_cast<uint64_t>(Params::LongMax)) {
+                DECIMAL3_COUNT(ParseOverflow);
+                return Decimal3::ErrorValue;
+            }
+            return _negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+        }
+
+        /// ends the current token and returns its value
+        Decimal3 take() {
+            int64_t v = _state == State::Done ? _value : value();
+            _state = State::Idle;
+            return Decimal3(v);
+        }
+
+        char _separator;
+        State _state = State::Idle;
+        bool _negative = false;
+        bool _has_integer = false;
+        bool _has_fraction = false;
+        bool _sticky = false;
+        int _fraction_digits = 0;
+        uint64_t _integer = 0;
+        uint64_t _fraction = 0;
+        /// value of a Done token
+        int64_t _value = 0;
+    };
+}
+
+#endif // DECIMAL3_STREAM_H
@@ -1,7 +1,34 @@
 #include <iostream>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
 #include "harness.h"
 #include "harness_extended.h"
 #include "decimal3.h"
+#include "decimal3_atomic.h"
+#include "decimal3_batch.h"
+#include "decimal3_codec.h"
+#include "decimal3_column.h"
+#include "decimal3_context.h"
+#include "decimal3_csv.h"
+#include "decimal3_divisor.h"
+#include "decimal3_expr.h"
+#include "decimal3_filter.h"
+#include "decimal3_histogram.h"
+#include "decimal3_packed.h"
+#include "decimal3_reduce.h"
+#include "decimal3_rescale.h"
+#include "decimal3_sort.h"
+#include "decimal3_stats.h"
+#include "decimal3_stream.h"
 
 namespace P = Decimal3Params;
 
@@ -15,6 +42,23 @@ static inline int64_t d3value_from(T value) {
     return Decimal3::from(value).value();
 }
 
+static std::vector<Decimal3> random_decimals(size_t n, unsigned seed)
+{
+    // mostly small values, with large values and errors mixed in
+    std::mt19937_64 rng(seed);
+    std::vector<Decimal3> values(n);
+    for (auto& v : values) {
+        switch (rng() % 8) {
+        case 0:  v = Decimal3(static_cast<int64_t>(rng())); break;
+        case 1:  v = Decimal3(Decimal3::ErrorValue); break;
+        case 2:  v = Decimal3(static_cast<int64_t>(rng() % 2 ? P::LongMax : P::LongMin)); break;
+        case 3:  v = Decimal3(static_cast<int64_t>(rng() % 20000000000LL) - 10000000000LL); break;
+        default: v = Decimal3(static_cast<int64_t>(rng() % 2000000) - 1000000); break;
+        }
+    }
+    return values;
+}
+
 void decimal3_initialize(test_runner* t)
 {
     int count = 0;
@@ -101,6 +145,674 @@ void decimal3_initialize_from_string(test_runner* t)
     LONG_EQ(t, d3value_from("9223372036854775.805"), 9223372036854775805LL, test_title, ++count);
 }
 
+void decimal3_from_chars(test_runner* t)
+{
+    int count = 0;
+    const char* test_title = "from_chars test %d";
+    auto parse = [](const char* text, int64_t& value) {
+        return Decimal3::parse_chars_to_internal_long(text, text + strlen(text), value);
+    };
+    int64_t v = 0;
+    std::from_chars_result r;
+
+    r = parse("123.456", v);
+    IS_TRUE(t, r.ec == std::errc() && v == 123456LL && *r.ptr == '\0', test_title, ++count);
+    r = parse("-0.5", v);
+    IS_TRUE(t, r.ec == std::errc() && v == -500LL, test_title, ++count);
+    r = parse("-.0015", v);
+    IS_TRUE(t, r.ec == std::errc() && v == -2LL, test_title, ++count);
+    r = parse("12.3449,next", v);
+    IS_TRUE(t, r.ec == std::errc() && v == 12345LL && *r.ptr == ',', test_title, ++count);
+    r = parse("0.99951234567890123", v);
+    IS_TRUE(t, r.ec == std::errc() && v == 1000LL && *r.ptr == '\0', test_title, ++count);
+    r = parse("00000000000000000000042.5", v);
+    IS_TRUE(t, r.ec == std::errc() && v == 42500LL, test_title, ++count);
+    r = parse("1234567890123456", v);
+    IS_TRUE(t, r.ec == std::errc() && v == 1234567890123456000LL, test_title, ++count);
+
+    count = 0;
+    test_title = "from_chars error test %d";
+    v = 7;
+    r = parse("abc", v);
+    IS_TRUE(t, r.ec == std::errc::invalid_argument && v == 7 && *r.ptr == 'a', test_title, ++count);
+    r = parse("-.", v);
+    IS_TRUE(t, r.ec == std::errc::invalid_argument && v == 7, test_title, ++count);
+    r = parse("", v);
+    IS_TRUE(t, r.ec == std::errc::invalid_argument, test_title, ++count);
+    r = parse("9223372036854775.808x", v);
+    IS_TRUE(t, r.ec == std::errc::result_out_of_range && *r.ptr == 'x' && v == 7, test_title, ++count);
+    r = parse("123456789012345678901234", v);
+    IS_TRUE(t, r.ec == std::errc::result_out_of_range && *r.ptr == '\0', test_title, ++count);
+
+    count = 0;
+    test_title = "from_chars bounded input test %d";
+    const char buffer[] = "98765.4321|1.5";
+    Decimal3 d;
+    r = Decimal3::from_chars(buffer, buffer + 3, d);
+    IS_TRUE(t, r.ec == std::errc() && d.value() == 987000LL && r.ptr == buffer + 3, test_title, ++count);
+    r = Decimal3::from_chars(buffer, buffer + 7, d);
+    IS_TRUE(t, r.ec == std::errc() && d.value() == 98765400LL && r.ptr == buffer + 7, test_title, ++count);
+    r = Decimal3::from_chars(buffer, buffer + sizeof(buffer) - 1, d);
+    IS_TRUE(t, r.ec == std::errc() && d.value() == 98765432LL && *r.ptr == '|', test_title, ++count);
+
+    count = 0;
+    test_title = "legacy string parse test %d";
+    LONG_EQ(t, d3value_from("  +12.5"), 12500LL, test_title, ++count);
+    LONG_EQ(t, d3value_from("abc"), 0LL, test_title, ++count);
+    LONG_EQ(t, d3value_from(""), 0LL, test_title, ++count);
+    LONG_EQ(t, d3value_from("-0.25"), -250LL, test_title, ++count);
+
+    // every shape of up to 16 integer and 6 fraction digits
+    std::mt19937_64 rng(3);
+    int mismatch = 0;
+    for (int i = 0; i < 20000; i++) {
+        int int_digits = static_cast<int>(rng() % 17);
+        int frac_digits = static_cast<int>(rng() % 7);
+        char text[32];
+        char* p = text;
+        int64_t integer = 0, fraction = 0;
+        bool negative = rng() % 2;
+        if (negative)
+            *p++ = '-';
+        for (int k = 0; k < int_digits; k++) {
+            int d = static_cast<int>(rng() % 10);
+            *p++ = static_cast<char>('0' + d);
+            integer = integer * 10 + d;
+        }
+        if (frac_digits > 0)
+            *p++ = '.';
+        for (int k = 0; k < frac_digits; k++) {
+            int d = static_cast<int>(rng() % 10);
+            *p++ = static_cast<char>('0' + d);
+            if (k < 4)
+                fraction = fraction * 10 + d;
+        }
+        *p = '\0';
+        if (int_digits == 0 && frac_digits == 0)
+            continue;
+        for (int k = frac_digits; k < 4; k++)
+            fraction *= 10;
+        int64_t expect = P::ErrorValue;
+        if (integer <= P::MaxValue) {
+            uint64_t magnitude = static_cast<uint64_t>(integer) * 1000 + (fraction + 5) / 10;
+            if (magnitude <= static_cast<uint64_t>(P::LongMax))
+                expect = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+        }
+        mismatch += d3value_from(static_cast<const char*>(text)) != expect;
+    }
+    INT_EQ(t, mismatch, 0, "random string parse matches reference");
+}
+
+static std::string d3text(int64_t value, Decimal3Format format = Decimal3Format::Fixed)
+{
+    char buf[32];
+    auto r = Decimal3(value).to_chars(buf, buf + sizeof(buf), format);
+    return std::string(buf, r.ptr);
+}
+
+void decimal3_to_chars(test_runner* t)
+{
+    int count = 0;
+    const char* test_title = "to_chars test %d";
+    STR_EQ(t, d3text(123456).c_str(), "123.456", test_title, ++count);
+    STR_EQ(t, d3text(1500).c_str(), "1.500", test_title, ++count);
+    STR_EQ(t, d3text(-20).c_str(), "-0.020", test_title, ++count);
+    STR_EQ(t, d3text(0).c_str(), "0.000", test_title, ++count);
+    STR_EQ(t, d3text(P::LongMax).c_str(), "9223372036854775.807", test_title, ++count);
+    STR_EQ(t, d3text(-P::LongMax).c_str(), "-9223372036854775.807", test_title, ++count);
+    STR_EQ(t, d3text(P::ErrorValue).c_str(), "NaN", test_title, ++count);
+
+    count = 0;
+    test_title = "to_chars trimmed test %d";
+    STR_EQ(t, d3text(1500, Decimal3Format::Trimmed).c_str(), "1.5", test_title, ++count);
+    STR_EQ(t, d3text(-20, Decimal3Format::Trimmed).c_str(), "-0.02", test_title, ++count);
+    STR_EQ(t, d3text(3000, Decimal3Format::Trimmed).c_str(), "3", test_title, ++count);
+    STR_EQ(t, d3text(1001, Decimal3Format::Trimmed).c_str(), "1.001", test_title, ++count);
+    STR_EQ(t, d3text(0, Decimal3Format::Trimmed).c_str(), "0", test_title, ++count);
+
+    count = 0;
+    test_title = "to_chars small buffer test %d";
+    char small[8];
+    auto r = d3(1234.5).to_chars(small, small + 8);
+    IS_TRUE(t, r.ec == std::errc() && r.ptr == small + 8 && memcmp(small, "1234.500", 8) == 0, test_title, ++count);
+    r = d3(12345.5).to_chars(small, small + 8);
+    IS_TRUE(t, r.ec == std::errc::value_too_large && r.ptr == small + 8, test_title, ++count);
+
+    std::mt19937_64 rng(4);
+    int mismatch = 0;
+    for (int i = 0; i < 10000; i++) {
+        int64_t v = static_cast<int64_t>(rng()) >> (rng() % 60);
+        if (v == P::ErrorValue)
+            continue;
+        char buf[P::MaxTextLength];
+        for (auto format : { Decimal3Format::Fixed, Decimal3Format::Trimmed }) {
+            auto w = Decimal3(v).to_chars(buf, buf + sizeof(buf), format);
+            int64_t parsed = 0;
+            auto p = Decimal3::parse_chars_to_internal_long(buf, w.ptr, parsed);
+            mismatch += w.ec != std::errc() || p.ec != std::errc() || p.ptr != w.ptr || parsed != v;
+        }
+    }
+    INT_EQ(t, mismatch, 0, "to_chars round trips through from_chars");
+
+    count = 0;
+    test_title = "batch to_chars test %d";
+    Decimal3 column[] = { d3(1), d3(-2.5), Decimal3(Decimal3::ErrorValue), d3(0.125) };
+    char text[64];
+    r = Decimal3Batch::to_chars(text, text + sizeof(text), column, 4);
+    STR_EQ(t, std::string(text, r.ptr).c_str(), "1.000,-2.500,NaN,0.125", test_title, ++count);
+    r = Decimal3Batch::to_chars(text, text + sizeof(text), column, 4, ';', Decimal3Format::Trimmed);
+    STR_EQ(t, std::string(text, r.ptr).c_str(), "1;-2.5;NaN;0.125", test_title, ++count);
+    r = Decimal3Batch::to_chars(text, text + 10, column, 4);
+    IS_TRUE(t, r.ec == std::errc::value_too_large && r.ptr == text + 10, test_title, ++count);
+    r = Decimal3Batch::to_chars(text, text + sizeof(text), column, 0);
+    IS_TRUE(t, r.ec == std::errc() && r.ptr == text, test_title, ++count);
+}
+
+void decimal3_multiply_divide(test_runner* t)
+{
+    int count = 0;
+    const char* test_title = "exact multiply test %d";
+    LONG_EQ(t, (d3(3e6) * d3(4e6)).value(), 12000000000000000LL, test_title, ++count);
+    LONG_EQ(t, (d3(-3e6) * d3(4e6)).value(), -12000000000000000LL, test_title, ++count);
+    LONG_EQ(t, (d3(-3e6) * d3(-4e6)).value(), 12000000000000000LL, test_title, ++count);
+    LONG_EQ(t, (d3(-1.111) * d3(2.222)).value(), -2469LL, test_title, ++count);
+    LONG_EQ(t, (d3(123456.789) * d3(1000.001)).value(), 123456912457LL, test_title, ++count); // 123456912.456789
+    LONG_EQ(t, (Decimal3(P::LongMax) * d3(1)).value(), P::LongMax, test_title, ++count);
+    LONG_EQ(t, (Decimal3(-P::LongMax) * d3(1)).value(), -P::LongMax, test_title, ++count);
+
+    count = 0;
+    test_title = "multiply overflow test %d";
+    LONG_EQ(t, (d3(4e9) * d3(4e9)).value(), P::ErrorValue, test_title, ++count);
+    LONG_EQ(t, (d3(-4e9) * d3(4e9)).value(), P::ErrorValue, test_title, ++count);
+    LONG_EQ(t, (d3(4e9) * d3(-4e9)).value(), P::ErrorValue, test_title, ++count);
+    LONG_EQ(t, (d3(-4e9) * d3(-4e9)).value(), P::ErrorValue, test_title, ++count);
+    LONG_EQ(t, (Decimal3(P::LongMax) * d3(1.001)).value(), P::ErrorValue, test_title, ++count);
+
+    count = 0;
+    test_title = "divide test %d";
+    LONG_EQ(t, (d3(10) / d3(3)).value(), 3333LL, test_title, ++count);
+    LONG_EQ(t, (d3(2) / d3(3)).value(), 667LL, test_title, ++count);
+    LONG_EQ(t, (d3(-2) / d3(3)).value(), -667LL, test_title, ++count);
+    LONG_EQ(t, (d3(2) / d3(-3)).value(), -667LL, test_title, ++count);
+    LONG_EQ(t, (d3(0.001) / d3(2)).value(), 1LL, test_title, ++count);
+    LONG_EQ(t, (d3(1e12) / d3(0.001)).value(), 1000000000000000000LL, test_title, ++count);
+    LONG_EQ(t, (Decimal3(P::LongMax) / d3(2)).value(), 4611686018427387904LL, test_title, ++count);
+    LONG_EQ(t, (Decimal3(-P::LongMax) / d3(-1)).value(), P::LongMax, test_title, ++count);
+
+    count = 0;
+    test_title = "divide error test %d";
+    LONG_EQ(t, (d3(1) / d3(0)).value(), P::ErrorValue, test_title, ++count);
+    LONG_EQ(t, (Decimal3(P::LongMax) / d3(0.5)).value(), P::ErrorValue, test_title, ++count);
+    LONG_EQ(t, (Decimal3(Decimal3::ErrorValue) / d3(1)).value(), P::ErrorValue, test_title, ++count);
+    LONG_EQ(t, (d3(1) / Decimal3(Decimal3::ErrorValue)).value(), P::ErrorValue, test_title, ++count);
+
+    Decimal3 x = d3(7.5);
+    x *= d3(2);
+    LONG_EQ(t, x.value(), 15000LL, "operator*=");
+    x /= d3(4);
+    LONG_EQ(t, x.value(), 3750LL, "operator/=");
+}
+
+void decimal_scales(test_runner* t)
+{
+    using Decimal2i = Decimal<2, int32_t>;
+    using Decimal4i = Decimal<4, int32_t>;
+    using Decimal6 = Decimal<6, int64_t>;
+    using Decimal8 = Decimal<8, int64_t>;
+
+    static_assert(sizeof(Decimal2i) == 4, "int32_t storage");
+    static_assert(sizeof(Decimal3) == 8, "Decimal3 stays a plain int64_t");
+    static_assert(std::is_trivially_copyable<Decimal3>::value, "Decimal3 is trivially copyable");
+    static_assert(Decimal2i::Params::MaxValue == 21474836, "int32 MaxValue");
+    static_assert(Decimal2i::ErrorValue == INT32_MIN, "int32 ErrorValue");
+    static_assert(Decimal8::Params::MaxValue == 92233720368LL, "scale 8 MaxValue");
+    static_assert(Decimal3::Params::MaxValue == P::MaxValue, "Decimal3Params alias");
+    static_assert(Decimal2i::Params::MaxTextLength == 12, "int32 text length");
+
+    int count = 0;
+    const char* test_title = "Decimal<2, int32_t> test %d";
+    INT_EQ(t, Decimal2i::from(1.256).value(), 126, test_title, ++count);
+    INT_EQ(t, Decimal2i::from("-12.345").value(), -1235, test_title, ++count);
+    INT_EQ(t, Decimal2i::from("21474836.47").value(), INT32_MAX, test_title, ++count);
+    IS_TRUE(t, Decimal2i::from("21474836.48").error(), test_title, ++count);
+    IS_TRUE(t, Decimal2i::from(21474837).error(), test_title, ++count);
+    INT_EQ(t, (Decimal2i::from(1.5) * Decimal2i::from(2.25)).value(), 338, test_title, ++count);
+    IS_TRUE(t, (Decimal2i::from(100000) * Decimal2i::from(1000)).error(), test_title, ++count);
+    INT_EQ(t, (Decimal2i::from(1) / Decimal2i::from(3)).value(), 33, test_title, ++count);
+    IS_TRUE(t, (Decimal2i::from(20000000) + Decimal2i::from(2000000)).error(), test_title, ++count);
+    char text[16];
+    auto r = Decimal2i::from(-0.5).to_chars(text, text + sizeof(text));
+    STR_EQ(t, std::string(text, r.ptr).c_str(), "-0.50", test_title, ++count);
+
+    count = 0;
+    test_title = "Decimal<4, int32_t> test %d";
+    INT_EQ(t, Decimal4i::from("0.12345").value(), 1235, test_title, ++count);
+    r = Decimal4i::from(1.25).to_chars(text, text + sizeof(text), DecimalFormat::Trimmed);
+    STR_EQ(t, std::string(text, r.ptr).c_str(), "1.25", test_title, ++count);
+
+    count = 0;
+    test_title = "Decimal<6, int64_t> test %d";
+    LONG_EQ(t, Decimal6::from("3.1415926535").value(), 3141593LL, test_title, ++count);
+    LONG_EQ(t, Decimal6::from(2.5).value(), 2500000LL, test_title, ++count);
+    LONG_EQ(t, (Decimal6::from(1.5) * Decimal6::from(1.5)).value(), 2250000LL, test_title, ++count);
+    r = Decimal6::from("-0.000001").to_chars(text, text + sizeof(text));
+    STR_EQ(t, std::string(text, r.ptr).c_str(), "-0.000001", test_title, ++count);
+
+    count = 0;
+    test_title = "Decimal<8, int64_t> test %d";
+    LONG_EQ(t, Decimal8::from("92233720368.54775807").value(), INT64_MAX, test_title, ++count);
+    IS_TRUE(t, Decimal8::from("92233720368.54775808").error(), test_title, ++count);
+    LONG_EQ(t, Decimal8::from("0.123456785").value(), 12345679LL, test_title, ++count);
+    LONG_EQ(t, (Decimal8::from(3e10) * Decimal8::from(2)).value(), 6000000000000000000LL, test_title, ++count);
+    IS_TRUE(t, (Decimal8::from(3e10) * Decimal8::from(4)).error(), test_title, ++count);
+    LONG_EQ(t, (Decimal8::from(1) / Decimal8::from(3)).value(), 33333333LL, test_title, ++count);
+    r = Decimal8::from("12.5").to_chars(text, text + sizeof(text), DecimalFormat::Trimmed);
+    STR_EQ(t, std::string(text, r.ptr).c_str(), "12.5", test_title, ++count);
+}
+
+void decimal3_column(test_runner* t)
+{
+    const size_t n = 203;
+    auto a = random_decimals(n, 5);
+    auto b = random_decimals(n, 6);
+
+    auto ca = Decimal3Column::from_vector(a);
+    auto cb = Decimal3Column::from_vector(b);
+    INT_EQ(t, static_cast<int>(ca.size()), static_cast<int>(n), "column size");
+    IS_TRUE(t, reinterpret_cast<uintptr_t>(ca.values()) % 64 == 0, "column values are cache line aligned");
+
+    size_t errors = 0;
+    for (auto& v : a)
+        errors += v.error();
+    INT_EQ(t, static_cast<int>(ca.null_count()), static_cast<int>(errors), "ErrorValue becomes null");
+
+    auto back = ca.to_vector();
+    int mismatch = 0;
+    for (size_t i = 0; i < n; i++)
+        mismatch += back[i].value() != a[i].value() || ca[i].value() != a[i].value();
+    INT_EQ(t, mismatch, 0, "column round trips to vector");
+
+    Decimal3Column out;
+    Decimal3Batch::add(ca, cb, out);
+    mismatch = 0;
+    for (size_t i = 0; i < n; i++)
+        mismatch += out[i].value() != (a[i] + b[i]).value();
+    INT_EQ(t, mismatch, 0, "column add matches operator+");
+
+    Decimal3Batch::subtract(ca, cb, out);
+    mismatch = 0;
+    for (size_t i = 0; i < n; i++)
+        mismatch += out[i].value() != (a[i] - b[i]).value();
+    INT_EQ(t, mismatch, 0, "column subtract matches operator-");
+
+    Decimal3Batch::multiply(ca, cb, out);
+    mismatch = 0;
+    for (size_t i = 0; i < n; i++)
+        mismatch += out[i].value() != (a[i] * b[i]).value();
+    INT_EQ(t, mismatch, 0, "column multiply matches operator*");
+
+    Decimal3Batch::scale(ca, d3(-2.5), ca);
+    mismatch = 0;
+    for (size_t i = 0; i < n; i++)
+        mismatch += ca[i].value() != (a[i] * d3(-2.5)).value();
+    INT_EQ(t, mismatch, 0, "column scale in place matches operator*");
+
+    Decimal3Column c(3);
+    c.push_back(d3(1.5));
+    c.push_null();
+    c.push_back(Decimal3(Decimal3::ErrorValue));
+    c.set(0, d3(2));
+    INT_EQ(t, static_cast<int>(c.size()), 6, "column push_back");
+    INT_EQ(t, static_cast<int>(c.null_count()), 2, "column null count");
+    LONG_EQ(t, c[0].value(), 2000LL, "column set");
+    LONG_EQ(t, c[3].value(), 1500LL, "column push_back value");
+    IS_TRUE(t, c[4].error() && c[5].error(), "column nulls read as ErrorValue");
+    c.resize(130);
+    IS_TRUE(t, c.valid(129) && c[129].value() == 0 && c.null_count() == 2, "column resize adds valid zeros");
+    c.resize(5);
+    LONG_EQ(t, static_cast<long long>(c.validity()[0]), 0x0FLL, "column bitmap clears rows past size");
+}
+
+void decimal3_packed(test_runner* t)
+{
+    // blocks of: random values and errors, a narrow price range, one repeated
+    // value, only errors, and a partial block at the end
+    auto values = random_decimals(300, 7);
+    std::mt19937_64 rng(8);
+    for (int i = 0; i < 200; i++)
+        values.push_back(Decimal3(100000 + static_cast<int64_t>(rng() % 5000)));
+    values.resize(values.size() + 128, d3(42.5));
+    values.resize(values.size() + 128, Decimal3(Decimal3::ErrorValue));
+    values.push_back(Decimal3(P::LongMax));
+    values.push_back(Decimal3(P::LongMin));
+    values.push_back(d3(-1));
+    const size_t n = values.size();
+
+    auto packed = Decimal3PackedColumn::from_vector(values);
+    INT_EQ(t, static_cast<int>(packed.size()), static_cast<int>(n), "packed size");
+    INT_EQ(t, static_cast<int>(packed.block_count()), static_cast<int>((n + 127) / 128), "packed block count");
+    IS_TRUE(t, Decimal3PackedColumn::from_array(nullptr, 0).empty(), "packed empty");
+
+    int mismatch = 0;
+    for (size_t i = 0; i < n; i++)
+        mismatch += packed[i].value() != values[i].value();
+    INT_EQ(t, mismatch, 0, "packed random access");
+
+    const Decimal3 bounds[][2] = {
+        { d3(-1000), d3(1000) }, { d3(100), d3(102.5) }, { d3(42.5), d3(42.5) },
+        { Decimal3(P::LongMin), Decimal3(P::LongMax) }, { Decimal3(Decimal3::ErrorValue), d3(0) },
+        { d3(5), d3(-5) },
+    };
+    for (auto isa : { Decimal3Simd::Isa::Scalar, Decimal3Simd::Isa::Avx2, Decimal3Simd::Isa::Avx512 }) {
+        Decimal3Simd::limit_isa(isa);
+        auto back = packed.to_vector();
+        mismatch = 0;
+        for (size_t i = 0; i < n; i++)
+            mismatch += back[i].value() != values[i].value();
+        INT_EQ(t, mismatch, 0, "packed decode round trips, isa %d", static_cast<int>(isa));
+
+        for (auto& b : bounds) {
+            size_t expected = 0;
+            for (auto& v : values)
+                expected += !v.error() && v >= b[0] && v <= b[1];
+            INT_EQ(t, static_cast<int>(packed.count_between(b[0], b[1])), static_cast<int>(expected),
+                   "packed count_between %lld, isa %d", static_cast<long long>(b[0].value()), static_cast<int>(isa));
+        }
+
+        auto prices = Decimal3PackedColumn::from_array(values.data() + 300, 328);
+        LONG_EQ(t, prices.sum().value(), Decimal3Batch::sum(values.data() + 300, 328).value(), "packed sum, isa %d", static_cast<int>(isa));
+        IS_TRUE(t, packed.sum().error(), "packed sum with errors, isa %d", static_cast<int>(isa));
+    }
+    Decimal3Simd::limit_isa(Decimal3Simd::Isa::Avx512);
+
+    // 13 bits per price instead of 64
+    auto prices = Decimal3PackedColumn::from_array(values.data() + 300, 128);
+    IS_TRUE(t, prices.memory_bytes() * 4 < 128 * sizeof(Decimal3), "packed prices are small");
+    IS_TRUE(t, Decimal3PackedColumn::from_vector({ Decimal3(P::LongMax), Decimal3(P::LongMin) }).sum() == d3(0), "packed full range sum");
+}
+
+void decimal3_filter(test_runner* t)
+{
+    using Decimal3Batch::Compare;
+    const size_t n = 203;
+    auto a = random_decimals(n, 9);
+    auto b = random_decimals(n, 10);
+    // equal pairs, so Equal and the inclusive compares see ties
+    for (size_t i = 0; i < n; i += 7)
+        b[i] = a[i];
+
+    auto matches = [](Compare op, Decimal3 x, Decimal3 y) {
+        if (x.error() || y.error())
+            return false;
+        switch (op) {
+        case Compare::Less:         return x < y;
+        case Compare::LessEqual:    return x <= y;
+        case Compare::Greater:      return x > y;
+        case Compare::GreaterEqual: return x >= y;
+        case Compare::Equal:        return x == y;
+        default:                    return x != y;
+        }
+    };
+    const Compare ops[] = { Compare::Less, Compare::LessEqual, Compare::Greater, Compare::GreaterEqual, Compare::Equal, Compare::NotEqual };
+    const Decimal3 constants[] = { d3(0), a[3], Decimal3(P::LongMin), Decimal3(P::LongMax), Decimal3(Decimal3::ErrorValue) };
+
+    std::vector<uint64_t> bitmap((n + 63) / 64);
+    std::vector<size_t> index(n);
+    for (auto isa : { Decimal3Simd::Isa::Scalar, Decimal3Simd::Isa::Avx2, Decimal3Simd::Isa::Avx512 }) {
+        Decimal3Simd::limit_isa(isa);
+        int mismatch = 0;
+        auto check = [&](size_t bits, size_t selected, auto expect) {
+            size_t count = 0;
+            for (size_t i = 0; i < n; i++) {
+                bool e = expect(i);
+                mismatch += e != (((bitmap[i / 64] >> (i % 64)) & 1) != 0);
+                mismatch += e && (count >= selected || index[count++] != i);
+            }
+            mismatch += bits != count || selected != count || (bitmap.back() >> (n % 64)) != 0;
+        };
+        for (Compare op : ops) {
+            for (Decimal3 k : constants) {
+                size_t bits = Decimal3Batch::filter(a.data(), n, op, k, bitmap.data());
+                size_t selected = Decimal3Batch::select(a.data(), n, op, k, index.data());
+                check(bits, selected, [&](size_t i) { return matches(op, a[i], k); });
+            }
+            size_t bits = Decimal3Batch::filter(a.data(), b.data(), n, op, bitmap.data());
+            size_t selected = Decimal3Batch::select(a.data(), b.data(), n, op, index.data());
+            check(bits, selected, [&](size_t i) { return matches(op, a[i], b[i]); });
+        }
+        INT_EQ(t, mismatch, 0, "filter and select compares, isa %d", static_cast<int>(isa));
+
+        const Decimal3 bounds[][2] = {
+            { d3(-500), d3(500) }, { Decimal3(Decimal3::ErrorValue), d3(0) }, { Decimal3(P::LongMin), Decimal3(P::LongMax) },
+            { d3(1), d3(-1) }, { a[5], a[5] },
+        };
+        mismatch = 0;
+        for (auto& r : bounds) {
+            size_t bits = Decimal3Batch::filter_between(a.data(), n, r[0], r[1], bitmap.data());
+            size_t selected = Decimal3Batch::select_between(a.data(), n, r[0], r[1], index.data());
+            check(bits, selected, [&](size_t i) { return !a[i].error() && a[i] >= r[0] && a[i] <= r[1]; });
+        }
+        INT_EQ(t, mismatch, 0, "filter and select between, isa %d", static_cast<int>(isa));
+
+        // apply the selection of a > 0: compact by bitmap, gather by index
+        Decimal3Batch::filter(a.data(), n, Compare::Greater, d3(0), bitmap.data());
+        size_t count = Decimal3Batch::to_selection(bitmap.data(), n, index.data());
+        std::vector<Decimal3> compacted(n), gathered(n);
+        INT_EQ(t, static_cast<int>(Decimal3Batch::compact(a.data(), bitmap.data(), n, compacted.data())), static_cast<int>(count),
+               "compact count, isa %d", static_cast<int>(isa));
+        Decimal3Batch::gather(a.data(), index.data(), count, gathered.data());
+        mismatch = 0;
+        size_t j = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (a[i] > d3(0) && !a[i].error()) {
+                mismatch += j >= count || compacted[j].value() != a[i].value() || gathered[j].value() != a[i].value();
+                j++;
+            }
+        }
+        INT_EQ(t, mismatch + static_cast<int>(j != count), 0, "compact and gather, isa %d", static_cast<int>(isa));
+    }
+    Decimal3Simd::limit_isa(Decimal3Simd::Isa::Avx512);
+}
+
+void decimal3_histogram(test_runner* t)
+{
+    // slippage-like samples over several magnitudes, of both signs
+    std::mt19937_64 rng(11);
+    std::vector<Decimal3> samples;
+    for (int i = 0; i < 20000; i++) {
+        int64_t m = static_cast<int64_t>(rng() % 1000000) >> (rng() % 16);
+        samples.push_back(Decimal3(i % 3 == 0 ? -m : m));
+    }
+    samples.push_back(Decimal3(P::LongMax));
+    samples.push_back(Decimal3(P::LongMin));
+
+    // filled by 4 threads and merged
+    std::vector<Decimal3Histogram<>> parts(4);
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < parts.size(); k++) {
+        threads.emplace_back([&samples, &parts, k] {
+            for (size_t i = k; i < samples.size(); i += 4)
+                parts[k].add(samples[i]);
+            parts[k].add(Decimal3(Decimal3::ErrorValue));
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    Decimal3Histogram<> h;
+    for (auto& part : parts)
+        h += part;
+    Decimal3Histogram<> single;
+    single.add(samples.data(), samples.size());
+
+    LONG_EQ(t, static_cast<long long>(h.count()), static_cast<long long>(samples.size()), "histogram count");
+    LONG_EQ(t, static_cast<long long>(h.errors()), 4LL, "histogram errors are counted apart");
+    IS_TRUE(t, h.min() == Decimal3(P::LongMin) && h.max() == Decimal3(P::LongMax), "histogram exact min and max");
+    LONG_EQ(t, h.mean().value(), Decimal3Batch::mean(samples.data(), samples.size()).value(), "histogram exact mean");
+
+    std::vector<Decimal3> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    int mismatch = 0;
+    for (double q : { 0.0, 0.001, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999, 1.0 }) {
+        Decimal3 exact = sorted[static_cast<size_t>(std::floor(q * static_cast<double>(sorted.size() - 1)))];
+        Decimal3 approx = h.quantile(q);
+        double tolerance = std::fabs(static_cast<double>(exact.value())) * Decimal3Histogram<>::relative_error() + 1;
+        mismatch += std::fabs(static_cast<double>(approx.value() - exact.value())) > tolerance;
+        mismatch += approx != single.quantile(q);
+    }
+    INT_EQ(t, mismatch, 0, "histogram quantiles within the relative error");
+    IS_TRUE(t, h.quantile(-0.1).error() && h.quantile(NAN).error() && Decimal3Histogram<>().quantile(0.5).error(), "histogram quantile errors");
+
+    uint64_t total = 0;
+    int64_t previous = Decimal3::ErrorValue;
+    mismatch = 0;
+    h.for_each_bucket([&](Decimal3 lo, Decimal3 hi, uint64_t count) {
+        mismatch += lo.value() <= previous || hi < lo;
+        previous = hi.value();
+        total += count;
+    });
+    IS_TRUE(t, mismatch == 0 && total == h.count(), "histogram buckets ascend and cover all samples");
+
+    Decimal3Histogram<2> coarse;
+    coarse.add(d3(0.001), 3);
+    coarse.add(d3(-1000));
+    INT_EQ(t, static_cast<int>(Decimal3Histogram<2>::memory_bytes()), 2 * 63 * 2 * 8, "histogram fixed memory");
+    LONG_EQ(t, coarse.quantile(0.5).value(), 1LL, "histogram small values are exact");
+    coarse.add(d3(5000), 0);
+    coarse.add(Decimal3(Decimal3::ErrorValue), 0);
+    IS_TRUE(t, coarse.max() == d3(0.001) && coarse.quantile(1) == d3(0.001) && coarse.count() == 4 && coarse.errors() == 0,
+            "histogram adds of no samples are ignored");
+    Decimal3Histogram<2> none;
+    none.add(d3(-7), 0);
+    IS_TRUE(t, none.empty() && none.min().error() && coarse.merge(none).min() == d3(-1000), "histogram without samples stays empty");
+    h.reset();
+    IS_TRUE(t, h.empty() && h.errors() == 0 && h.quantile(0.5).error(), "histogram reset");
+}
+
+using namespace Decimal3Literals;
+
+int64_t decimal3_second_unit_value();
+
+void decimal_rounding(test_runner* t)
+{
+    using HalfEven = Decimal<3, int64_t, DecimalRounding::HalfEven>;
+    using Floor    = Decimal<3, int64_t, DecimalRounding::Floor>;
+    using Ceiling  = Decimal<3, int64_t, DecimalRounding::Ceiling>;
+    using Truncate = Decimal<3, int64_t, DecimalRounding::Truncate>;
+    using Integer  = Decimal<0, int64_t, DecimalRounding::HalfEven>;
+
+    static_assert(std::is_same<Decimal3::rounding_type, DecimalRounding::HalfUp>::value, "Decimal3 rounds half up");
+    static_assert(HalfEven::from("0.0025").value() == 2, "constexpr banker's rounding");
+
+    int count = 0;
+    const char* test_title = "rounding parse test %d";
+    LONG_EQ(t, Decimal3::from("2.0005").value(),  2001LL, test_title, ++count);
+    LONG_EQ(t, Decimal3::from("-2.0005").value(), -2001LL, test_title, ++count);
+    LONG_EQ(t, HalfEven::from("2.0005").value(),  2000LL, test_title, ++count);
+    LONG_EQ(t, HalfEven::from("2.0015").value(),  2002LL, test_title, ++count);
+    LONG_EQ(t, HalfEven::from("-2.0005").value(), -2000LL, test_title, ++count);
+    LONG_EQ(t, HalfEven::from("2.00050001").value(), 2001LL, test_title, ++count);
+    LONG_EQ(t, HalfEven::from("2.00050000001").value(), 2001LL, test_title, ++count);
+    LONG_EQ(t, HalfEven::from("2.00050000000").value(), 2000LL, test_title, ++count);
+    LONG_EQ(t, Floor::from("2.0009").value(),     2000LL, test_title, ++count);
+    LONG_EQ(t, Floor::from("-2.0001").value(),   -2001LL, test_title, ++count);
+    LONG_EQ(t, Floor::from("-2.000").value(),    -2000LL, test_title, ++count);
+    LONG_EQ(t, Ceiling::from("2.00000001").value(), 2001LL, test_title, ++count);
+    LONG_EQ(t, Ceiling::from("-2.0009").value(), -2000LL, test_title, ++count);
+    LONG_EQ(t, Truncate::from("2.0009").value(),  2000LL, test_title, ++count);
+    LONG_EQ(t, Truncate::from("-2.0009").value(), -2000LL, test_title, ++count);
+
+    count = 0;
+    test_title = "rounding double test %d";
+    LONG_EQ(t, Integer::from(2.5).value(),   2LL, test_title, ++count);
+    LONG_EQ(t, Integer::from(3.5).value(),   4LL, test_title, ++count);
+    LONG_EQ(t, Integer::from(-2.5).value(), -2LL, test_title, ++count);
+    LONG_EQ(t, Floor::from(-1.2341).value(), -1235LL, test_title, ++count);
+    LONG_EQ(t, Ceiling::from(1.2341).value(), 1235LL, test_title, ++count);
+    LONG_EQ(t, Truncate::from(1.2349).value(), 1234LL, test_title, ++count);
+    // doubles next to their literal, 2.01 is 2.00999999999999978684...
+    LONG_EQ(t, Truncate::from(2.01).value(),  2010LL, test_title, ++count);
+    LONG_EQ(t, Floor::from(0.57).value(),      570LL, test_title, ++count);
+    LONG_EQ(t, Ceiling::from(-2.01).value(), -2010LL, test_title, ++count);
+    LONG_EQ(t, Ceiling::from(0.1).value(),     100LL, test_title, ++count);
+    LONG_EQ(t, Floor::from(-0.1).value(),     -100LL, test_title, ++count);
+    LONG_EQ(t, Truncate::from(2.0109999).value(), 2010LL, test_title, ++count);
+    LONG_EQ(t, Ceiling::from(2.0100001).value(),  2011LL, test_title, ++count);
+    {
+        // every value with 3 digits converts like its text
+        int mismatch = 0;
+        char text[32];
+        for (int64_t v = -2000000; v <= 2000000; v += 7) {
+            double x = static_cast<double>(v) / 1000.0;
+            snprintf(text, sizeof(text), "%.3f", x);
+            mismatch += Floor::from(x).value() != Floor::from(text).value();
+            mismatch += Ceiling::from(x).value() != Ceiling::from(text).value();
+            mismatch += Truncate::from(x).value() != Truncate::from(text).value();
+        }
+        INT_EQ(t, mismatch, 0, "directed rounding of doubles with 3 digits");
+    }
+    // above MaxRoundableAccurateNumD, 1234567890123456.75 before rounding
+    LONG_EQ(t, Decimal3::from(1234567890123.4567).value(), 1234567890123457LL, test_title, ++count);
+    LONG_EQ(t, Truncate::from(1234567890123.4567).value(), 1234567890123456LL, test_title, ++count);
+
+    count = 0;
+    test_title = "rounding multiply test %d";
+    // -2.468642
+    LONG_EQ(t, (Decimal3::from(-1.111) * Decimal3::from(2.222)).value(), -2469LL, test_title, ++count);
+    LONG_EQ(t, (Floor::from(-1.111) * Floor::from(2.222)).value(),       -2469LL, test_title, ++count);
+    LONG_EQ(t, (Ceiling::from(-1.111) * Ceiling::from(2.222)).value(),   -2468LL, test_title, ++count);
+    LONG_EQ(t, (Truncate::from(-1.111) * Truncate::from(2.222)).value(), -2468LL, test_title, ++count);
+    LONG_EQ(t, (Decimal3::from(0.05) * Decimal3::from(0.01)).value(), 1LL, test_title, ++count);
+    LONG_EQ(t, (HalfEven::from(0.05) * HalfEven::from(0.01)).value(), 0LL, test_title, ++count);
+    LONG_EQ(t, (HalfEven::from(0.15) * HalfEven::from(0.01)).value(), 2LL, test_title, ++count);
+    // 128-bit path: 4294967.297 * 0.5 = 2147483.6485
+    LONG_EQ(t, (Decimal3(4294967297LL) * Decimal3(500)).value(), 2147483649LL, test_title, ++count);
+    LONG_EQ(t, (HalfEven(4294967297LL) * HalfEven(500)).value(), 2147483648LL, test_title, ++count);
+    LONG_EQ(t, (HalfEven(-4294967297LL) * HalfEven(500)).value(), -2147483648LL, test_title, ++count);
+    LONG_EQ(t, (Floor(-4294967297LL) * Floor(500)).value(), -2147483649LL, test_title, ++count);
+    LONG_EQ(t, (Decimal3(5) * 0.5).value(), 3LL, test_title, ++count);
+    LONG_EQ(t, (HalfEven(5) * 0.5).value(), 2LL, test_title, ++count);
+    LONG_EQ(t, (Floor(-5) * 0.5).value(), -3LL, test_title, ++count);
+    LONG_EQ(t, (Ceiling(-5) * 0.5).value(), -2LL, test_title, ++count);
+    LONG_EQ(t, HalfEven::safe_fma(50, 10, 0), 0LL, test_title, ++count);
+    LONG_EQ(t, Floor::safe_fma(-50, 10, 0), -1LL, test_title, ++count);
+
+    count = 0;
+    test_title = "rounding divide test %d";
+    // 0.001 / 2 = 0.0005
+    LONG_EQ(t, (Decimal3(1) / Decimal3(2000)).value(),   1LL, test_title, ++count);
+    LONG_EQ(t, (Decimal3(-1) / Decimal3(2000)).value(), -1LL, test_title, ++count);
+    LONG_EQ(t, (HalfEven(1) / HalfEven(2000)).value(),   0LL, test_title, ++count);
+    LONG_EQ(t, (HalfEven(3) / HalfEven(2000)).value(),   2LL, test_title, ++count);
+    LONG_EQ(t, (Floor(-1) / Floor(2000)).value(),       -1LL, test_title, ++count);
+    LONG_EQ(t, (Ceiling(-1) / Ceiling(2000)).value(),    0LL, test_title, ++count);
+    LONG_EQ(t, (Ceiling(2) / Ceiling(3000)).value(),     1LL, test_title, ++count);
+    LONG_EQ(t, (Truncate(2000) / Truncate(3000)).value(), 666LL, test_title, ++count);
+    LONG_EQ(t, (Floor(-2000) / Floor(3000)).value(),   -667LL, test_title, ++count);
+    LONG_EQ(t, (Ceiling(1000) / 3.0).value(),           334LL, test_title, ++count);
+    LONG_EQ(t, (Decimal3(1000) / 3.0).value(),          333LL, test_title, ++count);
+}
+
+void decimal3_constexpr(test_runner* t)
+{
+    constexpr Decimal3 fee = 0.0025_d3;
+    constexpr Decimal3 threshold = 1'000'000.5_d3;
+    static_assert(fee.value() == 3, "literal rounds half up");
+    static_assert(threshold.value() == 1000000500LL, "literal with digit separators");
+    static_assert((-12.5_d3).value() == -12500LL, "negative literal");
+    static_assert((42_d3).value() == 42000LL, "integer literal");
+    static_assert((1.111_d3 * 2.222_d3).value() == 2469LL, "constexpr multiply");
+    static_assert((1.111_d3 + 2.222_d3 - 0.5_d3).value() == 2833LL, "constexpr add and subtract");
+    static_assert(Decimal3::from(0.1115).value() == 112LL, "constexpr from(double)");
+    static_assert(Decimal3::from("123.456789").value() == 123457LL, "constexpr from(const char*)");
+    static_assert(Decimal3::from(1e300).error(), "constexpr range check");
+    static_assert((Decimal3(P::LongMax) + 1.0).error(), "constexpr overflow");
+    static_assert((4.5_d3).to_double() == 4.5, "constexpr to_double");
+    static_assert((4.5_d3).to_int() == 4, "constexpr to_int");
+
+    LONG_EQ(t, fee.value(), 3LL, "constexpr literal value");
+    LONG_EQ(t, decimal3_second_unit_value(), 3000LL, "header used from a second translation unit");
+}
+
 void decimal3_arithmetic(test_runner* t)
 {
     LONG_EQ(t, (d3( 1.111) + d3( 2.222)).value(),  3333LL, "add two positive decimal");
@@ -132,6 +844,865 @@ void decimal3_arithmetic(test_runner* t)
     LONG_EQ(t, (d3(P::MaxAccurateNumD) * 1.5).value(), P::ErrorValue, "");
 }
 
+void decimal3_batch_arithmetic(test_runner* t)
+{
+    const size_t n = 1003;
+    auto a = random_decimals(n, 1);
+    auto b = random_decimals(n, 2);
+    std::vector<Decimal3> out(n);
+    Decimal3 k = d3(1.5);
+
+    const Decimal3Simd::Isa isas[] = {
+        Decimal3Simd::Isa::Scalar, Decimal3Simd::Isa::Avx2, Decimal3Simd::Isa::Avx512 };
+    for (auto isa : isas) {
+        Decimal3Simd::limit_isa(isa);
+        int isa_id = static_cast<int>(isa);
+        int mismatch = 0;
+
+        Decimal3Batch::add(a.data(), b.data(), out.data(), n);
+        for (size_t i = 0; i < n; i++)
+            mismatch += out[i].value() != (a[i] + b[i]).value();
+        INT_EQ(t, mismatch, 0, "batch add matches operator+ (isa %d)", isa_id);
+
+        mismatch = 0;
+        Decimal3Batch::subtract(a.data(), b.data(), out.data(), n);
+        for (size_t i = 0; i < n; i++)
+            mismatch += out[i].value() != (a[i] - b[i]).value();
+        INT_EQ(t, mismatch, 0, "batch subtract matches operator- (isa %d)", isa_id);
+
+        mismatch = 0;
+        Decimal3Batch::multiply(a.data(), b.data(), out.data(), n);
+        for (size_t i = 0; i < n; i++)
+            mismatch += out[i].value() != (a[i] * b[i]).value();
+        INT_EQ(t, mismatch, 0, "batch multiply matches operator* (isa %d)", isa_id);
+
+        mismatch = 0;
+        Decimal3Batch::scale(a.data(), k, out.data(), n);
+        for (size_t i = 0; i < n; i++)
+            mismatch += out[i].value() != (a[i] * k).value();
+        INT_EQ(t, mismatch, 0, "batch scale matches operator* (isa %d)", isa_id);
+
+        std::vector<Decimal3> inplace = a;
+        Decimal3Batch::multiply(inplace.data(), b.data(), inplace.data(), n);
+        mismatch = 0;
+        for (size_t i = 0; i < n; i++)
+            mismatch += inplace[i].value() != (a[i] * b[i]).value();
+        INT_EQ(t, mismatch, 0, "batch multiply in place (isa %d)", isa_id);
+
+        // empty vectors have no data to read
+        std::vector<Decimal3> empty;
+        Decimal3Batch::multiply(empty.data(), empty.data(), empty.data(), 0);
+        Decimal3Batch::scale(empty.data(), k, empty.data(), 0);
+        IS_TRUE(t, empty.empty(), "batch multiply of nothing (isa %d)", isa_id);
+    }
+    Decimal3Simd::limit_isa(Decimal3Simd::Isa::Avx512);
+
+    LONG_EQ(t, (Decimal3(Decimal3::ErrorValue) + d3(1)).value(), P::ErrorValue, "error propagates through add");
+    LONG_EQ(t, (d3(1) - Decimal3(Decimal3::ErrorValue)).value(), P::ErrorValue, "error propagates through subtract");
+    LONG_EQ(t, (Decimal3(Decimal3::ErrorValue) * d3(0)).value(), P::ErrorValue, "error propagates through multiply");
+    LONG_EQ(t, (Decimal3(P::LongMin) - d3(1)).value(), P::ErrorValue, "negative overflow on subtract");
+    LONG_EQ(t, (Decimal3(P::LongMin) + Decimal3(-1)).value(), P::ErrorValue, "negative overflow on add");
+}
+
+
+void decimal3_divisor(test_runner* t)
+{
+    const size_t n = 1003;
+    auto a = random_decimals(n, 3);
+    std::vector<Decimal3> out(n);
+    // small and large divisors, powers of two, signs and the extremes
+    const int64_t divisors[] = { 1, -1, 2, 3, 7, 1000, -1024, 1500, 999999, -123456789, 4294967296LL,
+                                 3LL << 51, P::LongMax, P::LongMin, 0, P::ErrorValue };
+    std::vector<int64_t> tested(std::begin(divisors), std::end(divisors));
+    std::mt19937_64 rng(11);
+    for (int i = 0; i < 64; i++)
+        tested.push_back(static_cast<int64_t>(rng() >> (rng() % 64)) * (i % 2 ? 1 : -1));
+
+    const Decimal3Simd::Isa isas[] = {
+        Decimal3Simd::Isa::Scalar, Decimal3Simd::Isa::Avx2, Decimal3Simd::Isa::Avx512 };
+    for (auto isa : isas) {
+        Decimal3Simd::limit_isa(isa);
+        int isa_id = static_cast<int>(isa);
+        int mismatch = 0;
+        for (int64_t b : tested) {
+            Decimal3Divisor divisor = Decimal3Divisor::from(Decimal3(b));
+            divisor.divide(a.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) {
+                int64_t expected = (a[i] / Decimal3(b)).value();
+                mismatch += out[i].value() != expected;
+                mismatch += (a[i] / divisor).value() != expected;
+            }
+        }
+        INT_EQ(t, mismatch, 0, "divisor matches operator/ (isa %d)", isa_id);
+
+        mismatch = 0;
+        for (int64_t b : tested) {
+            if (b == 0 || b > P::MaxValue || b < -P::MaxValue)
+                continue;
+            Decimal3Divisor divisor = Decimal3Divisor::from_integer(b);
+            divisor.divide(a.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++)
+                mismatch += out[i].value() != (a[i] / Decimal3::from(b)).value();
+        }
+        INT_EQ(t, mismatch, 0, "integer divisor matches operator/ (isa %d)", isa_id);
+
+        std::vector<Decimal3> inplace = a;
+        Decimal3Divisor::from(d3(0.3)).divide(inplace.data(), inplace.data(), n);
+        mismatch = 0;
+        for (size_t i = 0; i < n; i++)
+            mismatch += inplace[i].value() != (a[i] / d3(0.3)).value();
+        INT_EQ(t, mismatch, 0, "divisor in place (isa %d)", isa_id);
+    }
+    Decimal3Simd::limit_isa(Decimal3Simd::Isa::Avx512);
+
+    IS_TRUE(t, Decimal3Divisor::from(d3(0)).error(), "zero divisor");
+    IS_TRUE(t, Decimal3Divisor::from(Decimal3(P::ErrorValue)).error(), "error divisor");
+    IS_TRUE(t, (d3(1) / Decimal3Divisor::from_integer(0)).error(), "integer zero divisor");
+    LONG_EQ(t, (Decimal3(P::LongMax) / Decimal3Divisor::from_integer(INT64_MIN)).value(), -1LL, "integer divisor past MaxValue");
+    LONG_EQ(t, (d3(10) / Decimal3Divisor::from_integer(4)).value(), 2500LL, "integer divisor");
+}
+
+void decimal3_rescale(test_runner* t)
+{
+    LONG_EQ(t, Decimal3::from_scaled(12345, 2).value(), 123450LL, "from_scaled adds digits");
+    LONG_EQ(t, Decimal3::from_scaled(-12345, 3).value(), -12345LL, "from_scaled keeps digits");
+    LONG_EQ(t, Decimal3::from_scaled(12345, 4).value(), 1235LL, "from_scaled rounds half up");
+    LONG_EQ(t, Decimal3::from_scaled(-12345, 4).value(), -1235LL, "from_scaled rounds half away from zero");
+    LONG_EQ(t, Decimal3::from_scaled(123449999, 8).value(), 1234LL, "from_scaled rounds on all dropped digits");
+    LONG_EQ(t, Decimal3::from_scaled(P::MaxValue, 0).value(), P::MaxValue * 1000, "from_scaled at MaxValue");
+    LONG_EQ(t, Decimal3::from_scaled(P::MaxValue + 1, 0).value(), P::ErrorValue, "from_scaled past MaxValue");
+    LONG_EQ(t, Decimal3::from_scaled(P::LongMax, 3).value(), P::LongMax, "from_scaled at LongMax");
+    LONG_EQ(t, Decimal3::from_scaled(P::LongMin, 18).value(), -9223LL, "from_scaled at LongMin");
+    LONG_EQ(t, Decimal3::from_scaled(P::ErrorValue, 6).value(), P::ErrorValue, "from_scaled of ErrorValue");
+    LONG_EQ(t, Decimal3::from_scaled(1, 19).value(), P::ErrorValue, "from_scaled of 19 digits");
+
+    LONG_EQ(t, d3(123.45).to_scaled(4), 1234500LL, "to_scaled adds digits");
+    LONG_EQ(t, d3(-123.45).to_scaled(1), -1235LL, "to_scaled rounds half away from zero");
+    LONG_EQ(t, d3(0.499).to_scaled(0), 0LL, "to_scaled rounds down");
+    LONG_EQ(t, Decimal3(P::LongMax).to_scaled(4), INT64_MIN, "to_scaled past int64_t");
+    LONG_EQ(t, Decimal3(P::ErrorValue).to_scaled(2), INT64_MIN, "to_scaled of ErrorValue");
+    LONG_EQ(t, d3(1).to_scaled(-1), INT64_MIN, "to_scaled of negative digits");
+
+    using Cents = Decimal<2, int32_t>;
+    INT_EQ(t, Cents::from_scaled(12345, 4).value(), 123, "int32 from_scaled rounds");
+    INT_EQ(t, Cents::from_scaled(int64_t(1) << 40, 8).value(), 1099512, "int32 from_scaled from a large input");
+    INT_EQ(t, Cents::from_scaled(int64_t(1) << 40, 2).value(), Cents::ErrorValue, "int32 from_scaled past LongMax");
+    LONG_EQ(t, Cents::from_internal(Cents::Params::LongMax).to_scaled(18), INT64_MIN, "int32 to_scaled past int64_t");
+
+    // spans match the scalar conversions for every number of digits
+    const size_t n = 1003;
+    auto a = random_decimals(n, 13);
+    std::vector<int64_t> raw(n);
+    for (size_t i = 0; i < n; i++)
+        raw[i] = a[i].value();
+    std::vector<Decimal3> out(n);
+    std::vector<int64_t> scaled(n);
+    const Decimal3Simd::Isa isas[] = {
+        Decimal3Simd::Isa::Scalar, Decimal3Simd::Isa::Avx2, Decimal3Simd::Isa::Avx512 };
+    for (auto isa : isas) {
+        Decimal3Simd::limit_isa(isa);
+        int isa_id = static_cast<int>(isa);
+        int mismatch = 0;
+        for (int digits = -1; digits <= 19; digits++) {
+            Decimal3Batch::from_scaled(raw.data(), digits, out.data(), n);
+            Decimal3Batch::to_scaled(a.data(), digits, scaled.data(), n);
+            for (size_t i = 0; i < n; i++) {
+                mismatch += out[i].value() != Decimal3::from_scaled(raw[i], digits).value();
+                mismatch += scaled[i] != a[i].to_scaled(digits);
+            }
+        }
+        INT_EQ(t, mismatch, 0, "batch rescale matches scalar (isa %d)", isa_id);
+
+        std::vector<int64_t> inplace = raw;
+        Decimal3Batch::from_scaled(inplace.data(), 1, inplace.data(), n);
+        Decimal3Batch::to_scaled(inplace.data(), 1, inplace.data(), n);
+        mismatch = 0;
+        for (size_t i = 0; i < n; i++)
+            mismatch += inplace[i] != Decimal3::from_scaled(raw[i], 1).to_scaled(1);
+        INT_EQ(t, mismatch, 0, "batch rescale in place (isa %d)", isa_id);
+    }
+    Decimal3Simd::limit_isa(Decimal3Simd::Isa::Avx512);
+}
+
+void decimal3_reductions(test_runner* t)
+{
+    int count = 0;
+    // several blocks plus a ragged tail, without errors
+    const size_t n = 3 * Decimal3Batch::detail::ReduceBlock + 17;
+    std::mt19937_64 rng(7);
+    std::vector<Decimal3> values(n);
+    for (auto& v : values)
+        v = Decimal3(static_cast<int64_t>(rng() % 2000000000000LL) - 1000000000000LL);
+    values[n / 2] = Decimal3(P::LongMax);
+    values[n / 3] = Decimal3(P::LongMin);
+
+    Decimal3Detail::int128 total = 0;
+    int64_t lo = P::LongMax, hi = P::LongMin;
+    for (auto v : values) {
+        total += v.value();
+        lo = v.value() < lo ? v.value() : lo;
+        hi = v.value() > hi ? v.value() : hi;
+    }
+    Decimal3Detail::int128 rem = total % static_cast<Decimal3Detail::int128>(n);
+    int64_t average = static_cast<int64_t>(total / static_cast<Decimal3Detail::int128>(n));
+    if (2 * (rem < 0 ? -rem : rem) >= static_cast<Decimal3Detail::int128>(n))
+        average += total < 0 ? -1 : 1;
+
+    Decimal3ThreadPool single(1);
+    Decimal3ThreadPool several(3);
+    const Decimal3Simd::Isa isas[] = {
+        Decimal3Simd::Isa::Scalar, Decimal3Simd::Isa::Avx2, Decimal3Simd::Isa::Avx512 };
+    for (auto isa : isas) {
+        Decimal3Simd::limit_isa(isa);
+        for (Decimal3ThreadPool* pool : { &single, &several }) {
+            LONG_EQ(t, Decimal3Batch::sum(values.data(), n, *pool).value(), static_cast<int64_t>(total), "sum %d", ++count);
+            LONG_EQ(t, Decimal3Batch::min(values.data(), n, *pool).value(), lo, "min %d", ++count);
+            LONG_EQ(t, Decimal3Batch::max(values.data(), n, *pool).value(), hi, "max %d", ++count);
+            LONG_EQ(t, Decimal3Batch::mean(values.data(), n, *pool).value(), average, "mean %d", ++count);
+        }
+    }
+    Decimal3Simd::limit_isa(Decimal3Simd::Isa::Avx512);
+
+    // only the final sum is range checked
+    std::vector<Decimal3> wide = { Decimal3(P::LongMax), Decimal3(P::LongMax), Decimal3(-P::LongMax) };
+    LONG_EQ(t, Decimal3Batch::sum(wide.data(), wide.size()).value(), P::LongMax, "intermediate overflow");
+    wide.push_back(Decimal3(1));
+    LONG_EQ(t, Decimal3Batch::sum(wide.data(), wide.size()).value(), P::ErrorValue, "final overflow");
+    LONG_EQ(t, Decimal3Batch::mean(wide.data(), wide.size()).value(), P::LongMax / 4 + 1, "mean of overflowing sum");
+
+    // a task that calls back into its own pool runs the inner job inline
+    std::vector<int64_t> nested(8, 0);
+    several.run(nested.size(), [&](size_t k) {
+        nested[k] = Decimal3Batch::sum(values.data(), n, several).value();
+    });
+    Decimal3ThreadPool::shared().run(nested.size(), [&](size_t k) {
+        nested[k] += Decimal3Batch::mean(values.data(), n).value();
+    });
+    int mismatch = 0;
+    for (int64_t v : nested)
+        mismatch += v != static_cast<int64_t>(total) + average;
+    INT_EQ(t, mismatch, 0, "nested run on the same pool");
+
+    // many short jobs, so workers that wake late meet the next job
+    std::atomic<int> calls { 0 };
+    for (int k = 0; k < 2000; k++)
+        several.run(3, [&calls](size_t) { calls.fetch_add(1, std::memory_order_relaxed); });
+    INT_EQ(t, calls.load(), 6000, "short jobs in a row");
+
+    values[n - 1] = Decimal3(Decimal3::ErrorValue);
+    LONG_EQ(t, Decimal3Batch::sum(values.data(), n, several).value(), P::ErrorValue, "sum with error");
+    LONG_EQ(t, Decimal3Batch::min(values.data(), n, several).value(), P::ErrorValue, "min with error");
+    LONG_EQ(t, Decimal3Batch::max(values.data(), n, several).value(), P::ErrorValue, "max with error");
+    LONG_EQ(t, Decimal3Batch::mean(values.data(), n, several).value(), P::ErrorValue, "mean with error");
+
+    std::vector<Decimal3> halves = { Decimal3(1), Decimal3(2) };
+    LONG_EQ(t, Decimal3Batch::mean(halves.data(), 2).value(), 2, "mean rounds half away from zero");
+    halves = { Decimal3(-1), Decimal3(-2) };
+    LONG_EQ(t, Decimal3Batch::mean(halves.data(), 2).value(), -2, "negative mean rounds half away from zero");
+
+    LONG_EQ(t, Decimal3Batch::sum(values.data(), 0).value(), 0, "empty sum");
+    LONG_EQ(t, Decimal3Batch::min(values.data(), 0).value(), P::ErrorValue, "empty min");
+    LONG_EQ(t, Decimal3Batch::mean(values.data(), 0).value(), P::ErrorValue, "empty mean");
+}
+
+
+void decimal3_atomic(test_runner* t)
+{
+    Decimal3Atomic total;
+    Decimal3ShardedAccumulator sharded(3);
+    INT_EQ(t, static_cast<int>(sharded.size()), 4, "shards round up to a power of two");
+
+    // 4 threads adding and subtracting concurrently
+    std::vector<std::thread> threads;
+    for (int k = 0; k < 4; k++) {
+        threads.emplace_back([&total, &sharded, k] {
+            for (int i = 0; i < 20000; i++) {
+                total += d3(0.125);
+                total.fetch_sub(Decimal3(k));
+                sharded += d3(0.125);
+                sharded -= Decimal3(k);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    // 80000 * 0.125 - 20000 * (0 + 1 + 2 + 3) / 1000
+    LONG_EQ(t, total.load().value(), 9880000LL, "concurrent atomic adds");
+    LONG_EQ(t, sharded.load().value(), 9880000LL, "concurrent sharded adds");
+
+    Decimal3 expected = d3(1);
+    IS_TRUE(t, !total.compare_exchange(expected, d3(2)) && expected == d3(9880), "compare_exchange loads the value");
+    IS_TRUE(t, total.compare_exchange(expected, d3(2)) && total.load() == d3(2), "compare_exchange replaces the value");
+    LONG_EQ(t, (total -= d3(0.5)).value(), 1500LL, "-= returns the new value");
+    LONG_EQ(t, total.exchange(d3(7)).value(), 1500LL, "exchange returns the old value");
+
+    // overflow sticks, no later update brings the total back
+    total.store(Decimal3(P::LongMax - 1));
+    LONG_EQ(t, total.fetch_add(d3(0.001)).value(), P::LongMax - 1, "fetch_add returns the previous value");
+    IS_TRUE(t, (total += d3(0.001)).error() && total.error(), "atomic overflow");
+    total -= d3(1);
+    total.fetch_add(d3(-1));
+    IS_TRUE(t, total.error(), "atomic overflow sticks");
+
+    // an update that reads ErrorValue still acquires what was released with it
+    int payload = 0;
+    Decimal3Atomic flag;
+    std::thread writer([&payload, &flag] {
+        payload = 42;
+        flag.store(Decimal3(Decimal3::ErrorValue), std::memory_order_release);
+    });
+    while (!flag.fetch_add(d3(0), std::memory_order_acquire).error()) {
+    }
+    INT_EQ(t, payload, 42, "fetch_add of ErrorValue acquires");
+    writer.join();
+
+    sharded.reset();
+    sharded.add(Decimal3(P::LongMax));
+    sharded.add(d3(1));
+    IS_TRUE(t, sharded.load().error(), "sharded shard overflow");
+    sharded.subtract(d3(5));
+    IS_TRUE(t, sharded.load().error(), "sharded shard overflow sticks");
+
+    // shards in range whose sum is not
+    Decimal3ShardedAccumulator two(2);
+    std::thread([&two] { two.add(Decimal3(P::LongMax)); }).join();
+    std::thread([&two] { two.add(Decimal3(P::LongMax)); }).join();
+    IS_TRUE(t, two.load().error(), "sharded sum overflow");
+    two.reset();
+    IS_TRUE(t, two.load() == d3(0), "sharded reset");
+}
+
+void decimal3_stats_off(test_runner* t)
+{
+    // this suite is built like a user's build, with the counters compiled out;
+    // stats.cpp tests them with DECIMAL3_STATS=1
+    static_assert(!DECIMAL3_STATS, "the main suite is built without DECIMAL3_STATS");
+    auto before = Decimal3Stats::snapshot();
+    Decimal3(P::LongMax) + d3(1);
+    d3(1) / d3(0);
+    Decimal3::from("abc");
+    Decimal3::from(NAN);
+    LONG_EQ(t, static_cast<long long>((Decimal3Stats::snapshot() - before).total()), 0LL, "counters stay zero without DECIMAL3_STATS");
+}
+
+void decimal3_context(test_runner* t)
+{
+    using C = Decimal3Context;
+    namespace S = DecimalStatus;
+    S::clear();
+
+    Decimal3 x = C::add(C::multiply(d3(1.5), d3(2)), C::divide(d3(1), d3(4)));
+    LONG_EQ(t, x.value(), 3250, "formula value");
+    INT_EQ(t, S::test(), 0, "no flags for a valid formula");
+
+    LONG_EQ(t, C::add(Decimal3(P::LongMax), Decimal3(1)).value(), P::ErrorValue, "add overflow");
+    INT_EQ(t, S::test(), S::Overflow, "add raises overflow");
+    C::add(d3(1), d3(2));
+    INT_EQ(t, S::test(), S::Overflow, "flags are sticky");
+    S::clear(S::Overflow);
+
+    LONG_EQ(t, C::subtract(Decimal3(P::LongMin), Decimal3(1)).value(), P::ErrorValue, "subtract overflow");
+    LONG_EQ(t, C::multiply(Decimal3(P::LongMax), d3(2)).value(), P::ErrorValue, "multiply overflow");
+    INT_EQ(t, S::test(), S::Overflow, "subtract and multiply raise overflow");
+    S::clear();
+
+    LONG_EQ(t, C::divide(d3(1), d3(0)).value(), P::ErrorValue, "divide by zero");
+    LONG_EQ(t, C::divide(d3(1), 0.0).value(), P::ErrorValue, "divide by zero double");
+    INT_EQ(t, S::test(), S::DivideByZero, "divide raises divide by zero");
+    S::clear();
+
+    LONG_EQ(t, C::from(NAN).value(), P::ErrorValue, "nan");
+    LONG_EQ(t, C::divide(d3(1), INFINITY).value(), P::ErrorValue, "infinite divisor");
+    LONG_EQ(t, C::parse("1.5x", "1.5x" + 4).value(), P::ErrorValue, "trailing text");
+    INT_EQ(t, S::test(), S::Invalid, "invalid input");
+    S::clear();
+
+    LONG_EQ(t, C::from(0.1).value(), 100, "from 0.1");
+    LONG_EQ(t, C::parse("-12.345", "-12.345" + 7).value(), -12345, "parse");
+    INT_EQ(t, S::test(), 0, "exact conversion");
+    LONG_EQ(t, C::from(0.0005).value(), 1, "from 0.0005");
+    INT_EQ(t, S::test(), S::Inexact, "inexact conversion");
+    LONG_EQ(t, C::from(1e20).value(), P::ErrorValue, "from 1e20");
+    INT_EQ(t, S::test(S::Overflow), S::Overflow, "conversion overflow");
+
+    unsigned other = S::All;
+    std::thread([&] { other = S::test(); }).join();
+    INT_EQ(t, static_cast<int>(other), 0, "flags are per thread");
+    S::clear();
+
+    // the plain api no longer throws on a non-finite divisor
+    LONG_EQ(t, Decimal3::safe_divide(1000, INFINITY), P::ErrorValue, "safe_divide by infinity");
+    LONG_EQ(t, (d3(1) / NAN).value(), P::ErrorValue, "divide by nan");
+}
+
+
+void decimal3_batch_conversion(test_runner* t)
+{
+    // every tier of safe_double_to_internal_long, its boundaries, and non-finite values
+    std::mt19937_64 rng(3);
+    std::vector<double> doubles = { 0.0, -0.0, 0.0005, -0.0005, 0.0004999, 1.2345, -1.2345, 2.5e-4,
+        P::MaxRoundableAccurateNumD, -P::MaxRoundableAccurateNumD, std::nextafter(P::MaxRoundableAccurateNumD, 1e300),
+        P::MaxAccurateNumD, P::MaxValueD, -P::MaxValueD, P::MaxValueD * 2, NAN, INFINITY, -INFINITY, DBL_MIN, DBL_MAX };
+    while (doubles.size() < 2003) {
+        double magnitude = std::pow(10.0, static_cast<double>(rng() % 20) - 4);
+        double x = (static_cast<double>(rng() % 2000000) / 1000000.0 - 1.0) * magnitude;
+        doubles.push_back(rng() % 4 ? x : std::round(x * 10000.0) / 10000.0);
+    }
+    const size_t n = doubles.size();
+    auto decimals = random_decimals(n, 4);
+    std::vector<Decimal3> converted(n);
+    std::vector<double> back(n);
+
+    const Decimal3Simd::Isa isas[] = {
+        Decimal3Simd::Isa::Scalar, Decimal3Simd::Isa::Avx2, Decimal3Simd::Isa::Avx512 };
+    for (auto isa : isas) {
+        Decimal3Simd::limit_isa(isa);
+        int isa_id = static_cast<int>(isa);
+        int mismatch = 0;
+
+        Decimal3Batch::from_double(doubles.data(), converted.data(), n);
+        for (size_t i = 0; i < n; i++)
+            mismatch += converted[i].value() != Decimal3::from(doubles[i]).value();
+        INT_EQ(t, mismatch, 0, "batch from_double matches from(double) (isa %d)", isa_id);
+
+        mismatch = 0;
+        Decimal3Batch::to_double(decimals.data(), back.data(), n);
+        for (size_t i = 0; i < n; i++)
+            mismatch += back[i] != decimals[i].to_double();
+        INT_EQ(t, mismatch, 0, "batch to_double matches to_double() (isa %d)", isa_id);
+    }
+    Decimal3Simd::limit_isa(Decimal3Simd::Isa::Avx512);
+}
+
+
+void decimal3_csv(test_runner* t)
+{
+    int count = 0;
+    const std::string text =
+        "date,price,qty,note\r\n"
+        "2022-01-04, 1.5,+10,a\r\n"
+        "2022-01-05,\"-0.0005\",abc,b\n"
+        "2022-01-06,99999999999999999,3\n"
+        "2022-01-07,7\n"
+        "2022-01-08,2.25,4,c";
+    Decimal3Csv::Options options;
+    options.header = true;
+    auto r = Decimal3Csv::parse(text.data(), text.size(), { 2, 1 }, options);
+
+    IS_FALSE(t, static_cast<bool>(r.io_error), "no io error %d", ++count);
+    LONG_EQ(t, r.rows, 5, "rows %d", ++count);
+    INT_EQ(t, static_cast<int>(r.columns.size()), 2, "columns %d", ++count);
+    LONG_EQ(t, r.columns[1][0].value(), 1500, "blank padded field %d", ++count);
+    LONG_EQ(t, r.columns[0][0].value(), 10000, "leading plus %d", ++count);
+    LONG_EQ(t, r.columns[1][1].value(), -1, "quoted field %d", ++count);
+    LONG_EQ(t, r.columns[0][1].value(), P::ErrorValue, "not a number %d", ++count);
+    LONG_EQ(t, r.columns[1][2].value(), P::ErrorValue, "out of range %d", ++count);
+    LONG_EQ(t, r.columns[0][3].value(), P::ErrorValue, "missing field %d", ++count);
+    LONG_EQ(t, r.columns[1][4].value(), 2250, "last line without newline %d", ++count);
+
+    INT_EQ(t, static_cast<int>(r.errors.size()), 3, "error count %d", ++count);
+    if (r.errors.size() == 3) {
+        LONG_EQ(t, r.errors[0].row, 1, "error row %d", ++count);
+        LONG_EQ(t, r.errors[0].column, 2, "error column %d", ++count);
+        IS_TRUE(t, r.errors[0].ec == std::errc::invalid_argument, "error kind %d", ++count);
+        LONG_EQ(t, r.errors[1].row, 2, "error row %d", ++count);
+        IS_TRUE(t, r.errors[1].ec == std::errc::result_out_of_range, "error kind %d", ++count);
+        LONG_EQ(t, r.errors[2].row, 3, "error row %d", ++count);
+        LONG_EQ(t, r.errors[2].column, 2, "error column %d", ++count);
+    }
+
+    auto dup = Decimal3Csv::parse(text.data(), text.size(), { 1, 1 }, options);
+    IS_TRUE(t, dup.io_error == std::errc::invalid_argument, "duplicate columns %d", ++count);
+
+    // quoted delimiters before the selected columns, and empty lines
+    const std::string quoted =
+        "\"Acme, Inc\",101.5,3\n"
+        "\n"
+        "\"say \"\"hi, there\"\"\",\"2.5\",4\r\n"
+        "\r\n"
+        "plain,\"1,234.50\",5\n";
+    auto q = Decimal3Csv::parse(quoted.data(), quoted.size(), { 1, 2 });
+    LONG_EQ(t, q.rows, 3, "empty lines take no row %d", ++count);
+    if (q.rows == 3) {
+        LONG_EQ(t, q.columns[0][0].value(), 101500, "quoted delimiter before the column %d", ++count);
+        LONG_EQ(t, q.columns[1][0].value(), 3000, "quoted delimiter before the column %d", ++count);
+        LONG_EQ(t, q.columns[0][1].value(), 2500, "escaped quotes and delimiter %d", ++count);
+        LONG_EQ(t, q.columns[1][1].value(), 4000, "escaped quotes and delimiter %d", ++count);
+        LONG_EQ(t, q.columns[0][2].value(), P::ErrorValue, "quoted number with a delimiter %d", ++count);
+        LONG_EQ(t, q.columns[1][2].value(), 5000, "field after a quoted delimiter %d", ++count);
+    }
+    IS_TRUE(t, q.errors.size() == 1 && q.errors[0].row == 2 && q.errors[0].column == 1, "quoted error row %d", ++count);
+
+    // enough rows for several chunks, loaded from a file
+    auto values = random_decimals(50000, 8);
+    std::string big;
+    char buf[Decimal3Params::MaxTextLength];
+    for (size_t i = 0; i < values.size(); i++) {
+        big += std::to_string(i) + ';';
+        if (!values[i].error())
+            big.append(buf, values[i].to_chars(buf, buf + sizeof(buf)).ptr);
+        big += '\n';
+    }
+    const char* path = "decimal3_csv_test.csv";
+    FILE* fp = std::fopen(path, "wb");
+    std::fwrite(big.data(), 1, big.size(), fp);
+    std::fclose(fp);
+
+    Decimal3ThreadPool pool(3);
+    options.header = false;
+    options.delimiter = ';';
+    auto loaded = Decimal3Csv::load(path, { 1 }, options, pool);
+    std::remove(path);
+    LONG_EQ(t, loaded.rows, values.size(), "loaded rows %d", ++count);
+    int mismatch = 0;
+    size_t errors = 0;
+    for (size_t i = 0; i < values.size() && i < loaded.rows; i++) {
+        mismatch += loaded.columns[0][i].value() != values[i].value();
+        if (values[i].error())
+            mismatch += errors >= loaded.errors.size() || loaded.errors[errors++].row != i;
+    }
+    INT_EQ(t, mismatch, 0, "loaded values and error rows %d", ++count);
+    LONG_EQ(t, loaded.errors.size(), errors, "loaded error count %d", ++count);
+
+    auto missing = Decimal3Csv::load("decimal3_no_such_file.csv", { 0 });
+    IS_TRUE(t, static_cast<bool>(missing.io_error), "missing file %d", ++count);
+}
+
+
+void decimal3_codec(test_runner* t)
+{
+    int count = 0;
+    // random values, ErrorValue and the extremes round-trip
+    auto values = random_decimals(5000, 9);
+    std::vector<uint8_t> bytes;
+    Decimal3Codec::Encoder encoder;
+    encoder.encode(values.data(), values.size(), bytes);
+    std::vector<Decimal3> decoded;
+    Decimal3Codec::Decoder decoder;
+    auto r = decoder.decode(bytes.data(), bytes.data() + bytes.size(), decoded);
+    IS_TRUE(t, r.ec == std::errc() && r.ptr == bytes.data() + bytes.size(), "whole stream decoded %d", ++count);
+    LONG_EQ(t, decoded.size(), values.size(), "decoded count %d", ++count);
+    int mismatch = 0;
+    for (size_t i = 0; i < values.size() && i < decoded.size(); i++)
+        mismatch += decoded[i].value() != values[i].value();
+    INT_EQ(t, mismatch, 0, "lossless %d", ++count);
+
+    // a price series moving by a few thousandths
+    std::mt19937_64 rng(10);
+    std::vector<Decimal3> prices(100000);
+    int64_t price = 123456789;
+    for (auto& p : prices) {
+        price += static_cast<int64_t>(rng() % 41) - 20;
+        p = Decimal3(price);
+    }
+    std::vector<uint8_t> packed;
+    Decimal3Codec::Encoder price_encoder;
+    price_encoder.encode(prices.data(), prices.size() / 2, packed);
+    price_encoder.encode(prices.data() + prices.size() / 2, prices.size() - prices.size() / 2, packed);
+    IS_TRUE(t, packed.size() * 5 <= prices.size() * sizeof(int64_t), "at least 5x smaller %d", ++count);
+
+    // decode in small chunks that cut varints apart
+    std::vector<Decimal3> streamed(prices.size());
+    Decimal3Codec::Decoder chunked;
+    const uint8_t* p = packed.data();
+    const uint8_t* end = packed.data() + packed.size();
+    size_t n = 0;
+    std::vector<uint8_t> pending;
+    while (p != end) {
+        size_t take = 1 + rng() % 23;
+        if (take > static_cast<size_t>(end - p))
+            take = static_cast<size_t>(end - p);
+        pending.insert(pending.end(), p, p + take);
+        p += take;
+        auto c = chunked.decode(pending.data(), pending.data() + pending.size(), streamed.data() + n, streamed.size() - n);
+        n += c.count;
+        pending.erase(pending.begin(), pending.begin() + (c.ptr - pending.data()));
+    }
+    mismatch = pending.empty() && n == prices.size() ? 0 : 1;
+    for (size_t i = 0; i < n; i++)
+        mismatch += streamed[i].value() != prices[i].value();
+    INT_EQ(t, mismatch, 0, "chunked decode %d", ++count);
+
+    std::vector<uint8_t> corrupt(11, 0xFF);
+    std::vector<Decimal3> none;
+    Decimal3Codec::Decoder strict;
+    IS_TRUE(t, strict.decode(corrupt.data(), corrupt.data() + corrupt.size(), none).ec == std::errc::invalid_argument, "overlong varint %d", ++count);
+}
+
+
+void decimal3_stream(test_runner* t)
+{
+    // tokens of every shape: signs, long fractions, ties, overflow, and text
+    // that is not a number or only starts like one
+    std::mt19937_64 rng(19);
+    const char* fixed[] = { "0", "-0", "+1", "+-1", "++1", "-", "+", ".", "-.", ".5", "-.0005", "5.", "5.x",
+        "1.2.3", "12abc", "abc", "0.0005", "-0.0005", "0.00049999999", "1.23450000001", "9223372036854775.807",
+        "9223372036854775.8075", "-9223372036854775.807", "92233720368547758", "00000000000000000000001.5" };
+    std::vector<std::string> tokens(std::begin(fixed), std::end(fixed));
+    const char alphabet[] = "0123456789012345678901234567890123456789..--+x";
+    while (tokens.size() < 3000) {
+        std::string token;
+        size_t length = 1 + rng() % 24;
+        if (rng() % 2) {
+            // mostly well formed numbers
+            token = std::to_string(static_cast<int64_t>(rng() % 2000000000) - 1000000000);
+            token += "." + std::to_string(rng() % 100000000);
+            token.resize(std::min(token.size(), length + 4));
+        }
+        else {
+            for (size_t i = 0; i < length; i++)
+                token += alphabet[rng() % (sizeof(alphabet) - 1)];
+        }
+        tokens.push_back(token);
+    }
+
+    const char* delimiters[] = { " ", ",", "\n", "\r\n", ", ", "\t\t" };
+    std::string text;
+    std::vector<int64_t> expected;
+    for (auto& token : tokens) {
+        text += token;
+        text += delimiters[rng() % 6];
+        expected.push_back(Decimal3::from(token.c_str()).value());
+    }
+    // the last token is ended by finish()
+    text += "12.5";
+    expected.push_back(12500);
+
+    // chunks from single bytes to the whole text
+    const size_t chunk_sizes[] = { 1, 2, 3, 7, 64, 4096, text.size() };
+    for (size_t chunk : chunk_sizes) {
+        Decimal3Stream::Parser parser;
+        std::vector<int64_t> values;
+        auto emit = [&values](Decimal3 v) { values.push_back(v.value()); };
+        for (size_t i = 0; i < text.size(); i += chunk) {
+            size_t end = std::min(text.size(), i + chunk);
+            parser.feed(text.data() + i, text.data() + end, emit);
+        }
+        IS_TRUE(t, parser.pending(), "token cut off by the end (chunk %d)", static_cast<int>(chunk));
+        parser.finish(emit);
+        IS_TRUE(t, values == expected, "stream matches Decimal3::from (chunk %d)", static_cast<int>(chunk));
+    }
+
+    // into an array a few values at a time, resuming from ptr
+    Decimal3Stream::Parser parser;
+    std::vector<int64_t> values;
+    Decimal3 out[5];
+    const char* p = text.data();
+    const char* last = text.data() + text.size();
+    while (p != last) {
+        const char* end = last - p > 97 ? p + 97 : last;
+        auto r = parser.feed(p, end, out, 5);
+        for (size_t i = 0; i < r.count; i++)
+            values.push_back(out[i].value());
+        p = r.ptr;
+    }
+    Decimal3 tail;
+    IS_TRUE(t, parser.finish(tail), "finish into a value");
+    values.push_back(tail.value());
+    IS_TRUE(t, values == expected, "stream into an array");
+    IS_TRUE(t, !parser.finish(tail), "nothing left after finish");
+
+    Decimal3Stream::Parser semicolons(';');
+    std::string csv = "1.5;;2.25;\n-3;x;1,5;";
+    std::vector<int64_t> read;
+    semicolons.feed(csv.data(), csv.data() + csv.size(), [&read](Decimal3 v) { read.push_back(v.value()); });
+    IS_TRUE(t, (read == std::vector<int64_t>{ 1500, 2250, -3000, 0, 1000 }), "separator");
+}
+
+void decimal3_compare_sort(test_runner* t)
+{
+    int count = 0;
+    const Decimal3 error(Decimal3::ErrorValue);
+    IS_TRUE(t, d3(1.5) == d3("1.500"), "equal %d", ++count);
+    IS_TRUE(t, d3(1.5) != d3(1.501), "not equal %d", ++count);
+    IS_TRUE(t, d3(-2) < d3(1), "less %d", ++count);
+    IS_TRUE(t, d3(1) <= d3(1), "less or equal %d", ++count);
+    IS_TRUE(t, d3(0.001) > d3(0), "greater %d", ++count);
+    IS_TRUE(t, d3(0) >= d3(-0.001), "greater or equal %d", ++count);
+    IS_TRUE(t, error == error, "error equals itself %d", ++count);
+    IS_TRUE(t, error < Decimal3(P::LongMin), "error sorts first %d", ++count);
+    IS_FALSE(t, error > d3(0), "error is not greater %d", ++count);
+    static_assert(1.5_d3 < 2.5_d3, "constexpr comparison");
+
+    std::unordered_set<Decimal3> set = { d3(1), d3(2), error };
+    IS_TRUE(t, set.count(d3("1")) == 1 && set.count(error) == 1 && set.count(d3(3)) == 0, "hash %d", ++count);
+    IS_TRUE(t, std::hash<Decimal3>()(d3(1)) == std::hash<Decimal3>()(d3(1.0)), "hash of equal values %d", ++count);
+
+    const size_t sizes[] = { 0, 1, 50, 5000 };
+    for (size_t n : sizes) {
+        auto values = random_decimals(n, 11);
+        // duplicates, to check that argsort is stable
+        for (size_t i = 0; i + 1 < n; i += 7)
+            values[i + 1] = values[i];
+        auto expect = values;
+        std::sort(expect.begin(), expect.end());
+
+        auto sorted = values;
+        Decimal3Batch::sort(sorted.data(), n);
+        IS_TRUE(t, sorted == expect, "radix sort matches std::sort (n = %d)", static_cast<int>(n));
+
+        auto index = Decimal3Batch::argsort(values.data(), n);
+        int wrong = index.size() == n ? 0 : 1;
+        for (size_t i = 0; i < index.size(); i++) {
+            wrong += values[index[i]] != expect[i];
+            if (i > 0 && values[index[i]] == values[index[i - 1]])
+                wrong += index[i] < index[i - 1];
+        }
+        INT_EQ(t, wrong, 0, "argsort is a stable permutation (n = %d)", static_cast<int>(n));
+    }
+
+    // small values skip the high byte passes
+    std::vector<Decimal3> small = { d3(3), d3(-1), d3(2), d3(-1), d3(0) };
+    small.resize(300, d3(1));
+    Decimal3Batch::sort(small.data(), small.size());
+    IS_TRUE(t, std::is_sorted(small.begin(), small.end()) && small[0] == d3(-1) && small[2] == d3(0), "sort small values %d", ++count);
+}
+
+
+void decimal3_dot_fma(test_runner* t)
+{
+    int count = 0;
+    using Decimal3Detail::int128;
+    LONG_EQ(t, Decimal3::safe_fma(d3value_from(1.5), d3value_from(2.25), d3value_from(0.1)), 3475, "fma %d", ++count);
+    // 0.025 * 0.02 = 0.0005 rounds half up to 0.001
+    LONG_EQ(t, Decimal3::safe_fma(d3value_from(0.025), d3value_from(0.02), 0), 1, "fma rounds once %d", ++count);
+    LONG_EQ(t, Decimal3::safe_fma(P::LongMax, d3value_from(1), -1), P::LongMax - 1, "fma near the limit %d", ++count);
+    LONG_EQ(t, Decimal3::safe_fma(P::LongMax, d3value_from(1), 1), P::ErrorValue, "fma overflow %d", ++count);
+    LONG_EQ(t, Decimal3::safe_fma(P::ErrorValue, 0, 0), P::ErrorValue, "fma error %d", ++count);
+
+    // prices and quantities with a few large lanes that leave the vector path
+    const size_t n = 3 * Decimal3Batch::detail::ReduceBlock + 9;
+    std::mt19937_64 rng(12);
+    std::vector<Decimal3> price(n), qty(n);
+    for (size_t i = 0; i < n; i++) {
+        price[i] = Decimal3(static_cast<int64_t>(rng() % 2000000) - 1000000);
+        qty[i] = Decimal3(static_cast<int64_t>(rng() % 200000) - 100000);
+        if (i % 1000 == 7)
+            price[i] = Decimal3(static_cast<int64_t>(rng() % 20000000000000LL));
+    }
+    int128 exact = 0;
+    for (size_t i = 0; i < n; i++)
+        exact += static_cast<int128>(price[i].value()) * qty[i].value();
+    int64_t expect = static_cast<int64_t>(exact >= 0 ? (exact + 500) / 1000 : exact / 1000);
+
+    Decimal3ThreadPool pool(3);
+    const Decimal3Simd::Isa isas[] = {
+        Decimal3Simd::Isa::Scalar, Decimal3Simd::Isa::Avx2, Decimal3Simd::Isa::Avx512 };
+    for (auto isa : isas) {
+        Decimal3Simd::limit_isa(isa);
+        LONG_EQ(t, Decimal3Batch::dot(price.data(), qty.data(), n, pool).value(), expect, "dot (isa %d)", static_cast<int>(isa));
+        LONG_EQ(t, Decimal3Batch::dot(price.data(), qty.data(), 1).value(), (price[0] * qty[0]).value(), "dot of one term is operator* (isa %d)", static_cast<int>(isa));
+    }
+    Decimal3Simd::limit_isa(Decimal3Simd::Isa::Avx512);
+
+    // products wrap 128 bits on the way but cancel out
+    std::vector<Decimal3> big = { Decimal3(P::LongMax), Decimal3(P::LongMax), Decimal3(P::LongMax), Decimal3(P::LongMax), d3(2) };
+    std::vector<Decimal3> sign = { Decimal3(P::LongMax), Decimal3(P::LongMax), Decimal3(-P::LongMax), Decimal3(-P::LongMax), d3(3) };
+    LONG_EQ(t, Decimal3Batch::dot(big.data(), sign.data(), big.size()).value(), d3value_from(6), "intermediate wrap %d", ++count);
+    LONG_EQ(t, Decimal3Batch::dot(big.data(), sign.data(), 2).value(), P::ErrorValue, "dot overflow %d", ++count);
+    price[n / 2] = Decimal3(Decimal3::ErrorValue);
+    LONG_EQ(t, Decimal3Batch::dot(price.data(), qty.data(), n).value(), P::ErrorValue, "dot with error %d", ++count);
+    LONG_EQ(t, Decimal3Batch::dot(price.data(), qty.data(), 0).value(), 0, "empty dot %d", ++count);
+
+    auto a = random_decimals(1003, 13);
+    auto b = random_decimals(1003, 14);
+    auto c = random_decimals(1003, 15);
+    // the edges of the vector path: addends near 2^40, sums near 2^50 and halves
+    const int64_t edges[][3] = { { 1, 1, (1LL << 40) - 1 }, { 1, 1, 1LL << 40 }, { -1, 1, -(1LL << 40) + 1 },
+        { 1, 1, -(1LL << 40) }, { INT32_MAX, INT32_MAX, 0 }, { INT32_MIN, INT32_MIN, -1 }, { INT32_MIN, INT32_MAX, 1 },
+        { 33554432, 33554431, 0 }, { 33554432, 33554432, -500 }, { 500, 1, 0 }, { -500, 1, 0 }, { 1500, 1, -1 } };
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        a[i] = Decimal3(edges[i][0]);
+        b[i] = Decimal3(edges[i][1]);
+        c[i] = Decimal3(edges[i][2]);
+    }
+    std::vector<Decimal3> out(a.size());
+    for (auto isa : isas) {
+        Decimal3Simd::limit_isa(isa);
+        int isa_id = static_cast<int>(isa);
+        Decimal3Batch::fma(a.data(), b.data(), c.data(), out.data(), out.size());
+        int mismatch = 0;
+        for (size_t i = 0; i < out.size(); i++)
+            mismatch += out[i].value() != Decimal3::safe_fma(a[i].value(), b[i].value(), c[i].value());
+        INT_EQ(t, mismatch, 0, "batch fma (isa %d)", isa_id);
+
+        std::vector<Decimal3> inplace = c;
+        Decimal3Batch::fma(a.data(), b.data(), inplace.data(), inplace.data(), inplace.size());
+        mismatch = 0;
+        for (size_t i = 0; i < out.size(); i++)
+            mismatch += inplace[i].value() != out[i].value();
+        INT_EQ(t, mismatch, 0, "batch fma in place (isa %d)", isa_id);
+    }
+    Decimal3Simd::limit_isa(Decimal3Simd::Isa::Avx512);
+}
+
+void decimal3_expr(test_runner* t)
+{
+    using Decimal3Expr::lazy;
+    using Decimal3Expr::col;
+
+    // one rounding instead of one per operator
+    LONG_EQ(t, (d3(0.001) * d3(0.5) * d3(2)).value(), 2LL, "operators round each product");
+    LONG_EQ(t, Decimal3(lazy(d3(0.001)) * d3(0.5) * d3(2)).value(), 1LL, "formula rounds once");
+    LONG_EQ(t, Decimal3(lazy(d3(-0.001)) * d3(0.5)).value(), -1LL, "formula rounds half away from zero");
+    LONG_EQ(t, Decimal3(d3(1.5) * lazy(d3(2)) + d3(0.25) - d3(1)).value(), 2250LL, "formula with Decimal3 on the left");
+    LONG_EQ(t, Decimal3(-(lazy(d3(1.5)) * d3(2))).value(), -3000LL, "negated formula");
+    constexpr Decimal3 folded = Decimal3Expr::evaluate(lazy(Decimal3(1500)) * Decimal3(2000) - Decimal3(500));
+    static_assert(folded.value() == 2500, "constexpr formula");
+
+    // intermediates are not limited to LongMax, only the result is
+    const Decimal3 big(P::LongMax);
+    IS_TRUE(t, (big * d3(2) - big).error(), "operators overflow on the product");
+    LONG_EQ(t, Decimal3(lazy(big) * d3(2) - big).value(), P::LongMax, "formula keeps the wide product");
+    IS_TRUE(t, Decimal3(lazy(big) * d3(2)).error(), "formula result past LongMax");
+    IS_TRUE(t, Decimal3(lazy(big) * big * big).error(), "formula past 128 bits");
+    IS_TRUE(t, Decimal3(lazy(d3(1)) * Decimal3(P::ErrorValue) * d3(0)).error(), "ErrorValue operand");
+
+    // price * qty * fx + fee - rebate, element-wise against an exact reference
+    const size_t n = 1003;
+    std::mt19937_64 rng(17);
+    std::vector<Decimal3> price(n), qty(n), fee(n), out(n);
+    for (size_t i = 0; i < n; i++) {
+        price[i] = Decimal3(static_cast<int64_t>(rng() % 100000000) - 50000000);
+        qty[i] = Decimal3(static_cast<int64_t>(rng() % 10000000));
+        fee[i] = Decimal3(static_cast<int64_t>(rng() % 100000));
+    }
+    price[7] = Decimal3(P::ErrorValue);
+    qty[9] = Decimal3(P::LongMax);
+    const Decimal3 fx = d3(1.337);
+    const Decimal3 rebate = d3(0.125);
+    auto formula = col(price.data()) * col(qty.data()) * fx + col(fee.data()) - rebate;
+    // a column formula has no single value, it is read through evaluate()
+    static_assert(!std::is_convertible<decltype(formula), Decimal3>::value, "column formulas do not convert");
+    static_assert(std::is_convertible<decltype(lazy(fx) * rebate), Decimal3>::value, "value formulas convert");
+    Decimal3Expr::evaluate(formula, out.data(), n);
+    int mismatch = 0;
+    for (size_t i = 0; i < n; i++) {
+        using Decimal3Detail::int128;
+        using Decimal3Detail::uint128;
+        int64_t expected = P::ErrorValue;
+        if (!price[i].error()) {
+            int128 x = static_cast<int128>(price[i].value()) * qty[i].value() * fx.value()
+                     + (static_cast<int128>(fee[i].value()) - rebate.value()) * 1000000;
+            uint128 m = x < 0 ? 0 - static_cast<uint128>(x) : static_cast<uint128>(x);
+            uint128 q = (m + 500000) / 1000000;
+            if (q <= static_cast<uint128>(P::LongMax))
+                expected = x < 0 ? -static_cast<int64_t>(q) : static_cast<int64_t>(q);
+        }
+        mismatch += out[i].value() != expected;
+        mismatch += Decimal3Expr::evaluate(formula, i).value() != expected;
+    }
+    INT_EQ(t, mismatch, 0, "formula over arrays");
+    IS_TRUE(t, out[7].error() && out[9].error(), "formula errors over arrays");
+
+    // the output may be one of the columns
+    std::vector<Decimal3> inplace = price;
+    Decimal3Expr::evaluate(col(inplace.data()) * col(qty.data()) * fx + col(fee.data()) - rebate, inplace.data(), n);
+    mismatch = 0;
+    for (size_t i = 0; i < n; i++)
+        mismatch += inplace[i] != out[i];
+    INT_EQ(t, mismatch, 0, "formula in place");
+}
 
 
 int main()
@@ -141,10 +1712,34 @@ int main()
     decimal3_initialize(t);
     decimal3_initialize_from_double(t);
     decimal3_initialize_from_string(t);
+    decimal3_from_chars(t);
+    decimal3_to_chars(t);
     decimal3_arithmetic(t);
+    decimal3_multiply_divide(t);
+    decimal_scales(t);
+    decimal_rounding(t);
+    decimal3_constexpr(t);
+    decimal3_batch_arithmetic(t);
+    decimal3_batch_conversion(t);
+    decimal3_divisor(t);
+    decimal3_rescale(t);
+    decimal3_column(t);
+    decimal3_packed(t);
+    decimal3_filter(t);
+    decimal3_histogram(t);
+    decimal3_reductions(t);
+    decimal3_dot_fma(t);
+    decimal3_expr(t);
+    decimal3_context(t);
+    decimal3_atomic(t);
+    decimal3_stats_off(t);
+    decimal3_csv(t);
+    decimal3_codec(t);
+    decimal3_stream(t);
+    decimal3_compare_sort(t);
 
     int testok = is_test_ok(t);
     print_test_summary(t);
     free_test_runner(t);
     return testok ? 0 : 1;
-}
\ No newline at end of file
+}
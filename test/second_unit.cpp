@@ -0,0 +1,14 @@
+/**
+ * Includes the library from a second translation unit, so that duplicate
+ * definitions in the headers fail to link.
+ */
+#include <cstdint>
+#include "decimal3.h"
+#include "decimal3_batch.h"
+
+using namespace Decimal3Literals;
+
+int64_t decimal3_second_unit_value()
+{
+    return (1.5_d3 * 2.0_d3).value();
+}
@@ -0,0 +1,90 @@
+/**
+ * Tests the counters of decimal3_stats.h. This unit is built as its own
+ * executable with DECIMAL3_STATS=1, so the main suite keeps the default
+ * build where the counters are compiled out.
+ */
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "harness.h"
+#include "decimal3.h"
+#include "decimal3_stats.h"
+
+namespace P = Decimal3Params;
+
+template <class T>
+static inline Decimal3 d3(T value) {
+    return Decimal3::from(value);
+}
+
+static void decimal3_stats(test_runner* t)
+{
+    using Decimal3Stats::Counter;
+    using Cents = Decimal<2, int32_t>;
+    auto before = Decimal3Stats::thread_snapshot();
+    Decimal3::from(NAN);
+    d3(1) * INFINITY;
+    Decimal3::from(1e300);
+    Decimal3::from(P::MaxRoundableAccurateNumD * 2);
+    Decimal3::from(P::MaxAccurateNumD * 2);
+    Decimal3(P::LongMax) + d3(1);
+    Decimal3(P::LongMin) - d3(1);
+    Decimal3(P::LongMax) * d3(2);
+    Cents::from(20000000) * Cents::from(20000000);
+    Decimal3::safe_fma(P::LongMax, 2000, 0);
+    Decimal3(P::LongMax) / d3(0.5);
+    d3(1) / d3(0);
+    d3(1) / 0.0;
+    Decimal3::from("abc");
+    Decimal3::from("99999999999999999999");
+    Decimal3::from("9223372036854775.8075");
+
+    // errors passed along and ordinary values are not counted
+    Decimal3(P::ErrorValue) + d3(1);
+    Decimal3(P::ErrorValue) / d3(0);
+    d3(1.5) * d3(2) / d3(3) + Decimal3::from("4.25");
+    constexpr Decimal3 folded = Decimal3(P::LongMax) + Decimal3(1);
+    static_assert(folded.error(), "constant evaluation still returns ErrorValue");
+
+    auto delta = Decimal3Stats::thread_snapshot() - before;
+    LONG_EQ(t, delta[Counter::DoubleNonFinite], 2LL, "non-finite doubles");
+    LONG_EQ(t, delta[Counter::DoubleOutOfRange], 1LL, "double out of range");
+    LONG_EQ(t, delta[Counter::DoubleRounded], 1LL, "double rounded after scaling");
+    LONG_EQ(t, delta[Counter::DoublePrecisionLoss], 1LL, "double precision loss");
+    LONG_EQ(t, delta[Counter::AddOverflow], 2LL, "add / subtract overflow");
+    LONG_EQ(t, delta[Counter::MultiplyOverflow], 3LL, "multiply / fma overflow");
+    LONG_EQ(t, delta[Counter::DivideOverflow], 1LL, "divide overflow");
+    LONG_EQ(t, delta[Counter::DivideByZero], 2LL, "divide by zero");
+    LONG_EQ(t, delta[Counter::ParseInvalid], 1LL, "parse without digits");
+    LONG_EQ(t, delta[Counter::ParseOverflow], 2LL, "parse overflow");
+    LONG_EQ(t, delta.total(), 16LL, "total");
+
+    // counts of other threads are added up, also after they exit
+    auto all = Decimal3Stats::snapshot();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([] {
+            for (int k = 0; k < 1000; k++)
+                Decimal3(P::LongMax) + d3(1);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    auto all_delta = Decimal3Stats::snapshot() - all;
+    LONG_EQ(t, all_delta[Counter::AddOverflow], 4000LL, "counts of exited threads");
+    LONG_EQ(t, (Decimal3Stats::thread_snapshot() - before).total(), 16LL, "other threads are not in this one");
+    STR_EQ(t, Decimal3Stats::name(Counter::DoubleRounded), "double_rounded", "counter name");
+}
+
+int main()
+{
+    auto t = new_test_runner();
+
+    static_assert(DECIMAL3_STATS, "stats_test is built with DECIMAL3_STATS=1");
+    decimal3_stats(t);
+
+    int testok = is_test_ok(t);
+    print_test_summary(t);
+    free_test_runner(t);
+    return testok ? 0 : 1;
+}